@@ -0,0 +1,113 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* enough for any member of the snapshot, doubles and pointers included */
+#define ARENA_ALIGN		16
+
+struct ArenaBlock {
+	struct ArenaBlock *next;
+	size_t size;
+	size_t used;
+};
+
+static size_t
+arena_round (size_t size)
+{
+	return (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+}
+
+static struct ArenaBlock *
+arena_add_block (struct Arena *arena, size_t size)
+{
+	struct ArenaBlock *block;
+	
+	block = calloc (1, arena_round (sizeof (struct ArenaBlock)) + size);
+	if (!block) {
+		return NULL;
+	}
+	block->size = size;
+	block->next = arena->blocks;
+	arena->blocks = block;
+	
+	return block;
+}
+
+void
+arena_init (struct Arena *arena, size_t block_size)
+{
+	arena->blocks = NULL;
+	arena->block_size = arena_round (block_size ? block_size : 4096);
+}
+
+/* zeroed memory for size bytes, NULL when out of memory */
+void *
+arena_alloc (struct Arena *arena, size_t size)
+{
+	struct ArenaBlock *block = arena->blocks;
+	void *ptr;
+	
+	size = arena_round (size ? size : 1);
+	if (!block || block->size - block->used < size) {
+		/* outgrew the estimate: keep going with blocks twice as large */
+		if (block) {
+			arena->block_size *= 2;
+		}
+		block = arena_add_block (arena, size > arena->block_size ? size : arena->block_size);
+		if (!block) {
+			return NULL;
+		}
+	}
+	
+	ptr = (char *) block + arena_round (sizeof (struct ArenaBlock)) + block->used;
+	block->used += size;
+	
+	return ptr;
+}
+
+void *
+arena_memdup (struct Arena *arena, const void *data, size_t size)
+{
+	void *ptr;
+	
+	ptr = arena_alloc (arena, size);
+	if (ptr && size) {
+		memcpy (ptr, data, size);
+	}
+	
+	return ptr;
+}
+
+void
+arena_free (struct Arena *arena)
+{
+	struct ArenaBlock *block, *next;
+	
+	for (block = arena->blocks; block; block = next) {
+		next = block->next;
+		free (block);
+	}
+	arena->blocks = NULL;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_ARENA_H
+#define RANDR_GUI_ARENA_H
+
+#include <stddef.h>
+
+/* 
+ * Bump allocator backing one screen snapshot. Allocations are zeroed and
+ * never freed one by one; arena_free () drops them all at once. Blocks
+ * never move, so pointers into the arena stay valid while it lives.
+ */
+struct ArenaBlock;
+
+struct Arena {
+	struct ArenaBlock *blocks;	/* newest first, allocations come from it */
+	size_t block_size;		/* size of the next block */
+};
+
+void arena_init (struct Arena *arena, size_t block_size);
+void *arena_alloc (struct Arena *arena, size_t size);
+void *arena_memdup (struct Arena *arena, const void *data, size_t size);
+void arena_free (struct Arena *arena);
+
+#endif
@@ -0,0 +1,253 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "assign.h"
+#include "bitset.h"
+#include "log.h"
+
+/*
+ * The outputs sharing one pending crtc form a group, they need one crtc
+ * between them. A group is kept in the scratch of the crtc it is on now,
+ * set aside by the snapshot, so checking an edit allocates nothing:
+ * members are its outputs, drivers the crtcs able to drive all of them
+ * and match the crtc the matching gave it.
+ */
+
+static int
+is_group (struct CrtcInfo *crtc_info)
+{
+	return crtc_info->cur_noutput && crtc_info->cur_mode_id;
+}
+
+/* the first output of the group, for messages */
+static const char *
+group_name (struct ScreenInfo *screen_info, struct CrtcInfo *group)
+{
+	int i;
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		if (bitset_test (group->members, i)) {
+			return screen_info->outputs[i].info->name;
+		}
+	}
+	
+	return "output";
+}
+
+/* Kuhn's augmenting path search: find a crtc for group g, evicting others */
+static int
+augment (struct ScreenInfo *screen_info, int g)
+{
+	struct CrtcInfo *group = &screen_info->crtcs[g];
+	int c;
+	
+	for (c = 0; c < screen_info->n_crtc; c++) {
+		struct CrtcInfo *crtc_info = &screen_info->crtcs[c];
+		
+		if (!bitset_test (group->drivers, c) || crtc_info->visited) {
+			continue;
+		}
+		crtc_info->visited = 1;
+		if (crtc_info->owner < 0 || augment (screen_info, crtc_info->owner)) {
+			crtc_info->owner = g;
+			group->match = c;
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+/* the groups of the lit crtcs, 0 if they can not work */
+static int
+collect_groups (struct ScreenInfo *screen_info, FILE *err)
+{
+	size_t set_size = bitset_words (screen_info->n_output) * sizeof (unsigned long);
+	int i, j, k;
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		struct CrtcInfo *crtc_info = &screen_info->crtcs[i];
+		
+		crtc_info->match = -1;
+		crtc_info->owner = -1;
+		memset (crtc_info->members, 0, set_size);
+		if (!is_group (crtc_info)) {
+			continue;
+		}
+		bitset_fill (crtc_info->drivers, screen_info->n_crtc);
+		
+		for (j = 0; j < screen_info->n_crtc; j++) {
+			/* every bit, reflections included */
+			if ((screen_info->crtcs[j].rotations & crtc_info->cur_rotation) != 
+				 crtc_info->cur_rotation) {
+				bitset_clear (crtc_info->drivers, j);
+			}
+		}
+		
+		for (j = 0; j < screen_info->n_output; j++) {
+			struct OutputInfo *output = &screen_info->outputs[j];
+			
+			if (output->cur_crtc != crtc_info) {
+				continue;
+			}
+			for (k = 0; k < j; k++) {
+				if (bitset_test (crtc_info->members, k) && !bitset_test (output->clone_mask, k)) {
+					if (err) {
+						fprintf (err, "%s and %s can not show the same picture\n",
+									screen_info->outputs[k].info->name, output->info->name);
+					}
+					return 0;
+				}
+			}
+			bitset_set (crtc_info->members, j);
+			bitset_and (crtc_info->drivers, output->crtc_mask, screen_info->n_crtc);
+		}
+		
+		if (bitset_is_empty (crtc_info->drivers, screen_info->n_crtc)) {
+			if (err) {
+				fprintf (err, "%s: no crtc can drive it in this configuration\n",
+							group_name (screen_info, crtc_info));
+			}
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+/* move the pending state of group g, saved before the moves began, to its match */
+static void
+move_group (struct ScreenInfo *screen_info, int g, struct CrtcInfo *saved)
+{
+	struct CrtcInfo *group = &screen_info->crtcs[g];
+	struct CrtcInfo *crtc_info = &screen_info->crtcs[group->match];
+	int n_output = 0;
+	int i;
+	
+	crtc_info->cur_x = saved->cur_x;
+	crtc_info->cur_y = saved->cur_y;
+	crtc_info->cur_mode_id = saved->cur_mode_id;
+	crtc_info->cur_rotation = saved->cur_rotation;
+	crtc_info->changed = 1;
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		if (bitset_test (group->members, i)) {
+			screen_info->outputs[i].cur_crtc = crtc_info;
+			n_output++;
+		}
+	}
+	crtc_info->cur_noutput = n_output;
+	
+	log_debug ("%s: crtc 0x%lx -> 0x%lx", group_name (screen_info, group), 
+				  group->id, crtc_info->id);
+}
+
+/*
+ * Make sure every lit crtc of the pending state can really drive its
+ * outputs: each output lists the crtcs it can be connected to, and
+ * outputs sharing a crtc must be able to clone each other. Outputs sharing
+ * a crtc form a group, and a bipartite matching of groups to crtcs is
+ * found in one go, keeping groups on their current crtc where possible.
+ * Returns 1 when everything fits (moving groups as needed unless this is
+ * only a check), or 0 after reporting why on err, which may be NULL.
+ */
+static int
+match_crtcs (struct ScreenInfo *screen_info, FILE *err, int commit)
+{
+	struct CrtcInfo *saved = screen_info->saved_crtcs;
+	int g, c;
+	
+	if (!collect_groups (screen_info, err)) {
+		return 0;
+	}
+	
+	/* start from the current assignment, most of it is usually fine */
+	for (g = 0; g < screen_info->n_crtc; g++) {
+		struct CrtcInfo *group = &screen_info->crtcs[g];
+		
+		if (is_group (group) && bitset_test (group->drivers, g)) {
+			group->owner = g;
+			group->match = g;
+		}
+	}
+	
+	for (g = 0; g < screen_info->n_crtc; g++) {
+		struct CrtcInfo *group = &screen_info->crtcs[g];
+		
+		if (!is_group (group) || group->match >= 0) {
+			continue;
+		}
+		for (c = 0; c < screen_info->n_crtc; c++) {
+			screen_info->crtcs[c].visited = 0;
+		}
+		if (!augment (screen_info, g)) {
+			if (err) {
+				fprintf (err, "%s: not enough crtcs for all outputs\n", group_name (screen_info, group));
+			}
+			return 0;
+		}
+	}
+	
+	if (!commit) {
+		return 1;
+	}
+	
+	/* groups may trade crtcs, so take every state out before moving */
+	for (g = 0; g < screen_info->n_crtc; g++) {
+		saved[g] = screen_info->crtcs[g];
+	}
+	for (g = 0; g < screen_info->n_crtc; g++) {
+		struct CrtcInfo *group = &screen_info->crtcs[g];
+		
+		if (is_group (&saved[g]) && group->match != g) {
+			group->cur_noutput = 0;
+			group->cur_mode_id = None;
+			group->changed = 1;
+		}
+	}
+	for (g = 0; g < screen_info->n_crtc; g++) {
+		if (is_group (&saved[g]) && saved[g].match != g) {
+			move_group (screen_info, g, &saved[g]);
+		}
+	}
+	
+	if (screen_info->cur_output) {
+		screen_info->cur_crtc = screen_info->cur_output->cur_crtc;
+	}
+	
+	return 1;
+}
+
+int
+assign_crtcs (struct ScreenInfo *screen_info, FILE *err)
+{
+	return match_crtcs (screen_info, err, 1);
+}
+
+/* whether assign_crtcs () would succeed, without changing anything */
+int
+check_crtc_assignment (struct ScreenInfo *screen_info, FILE *err)
+{
+	return match_crtcs (screen_info, err, 0);
+}
@@ -0,0 +1,560 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * The RandR backend talking to a real X server.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/randr.h>
+
+#include "backend.h"
+#include "screen.h"
+#include "modeset.h"
+#include "trace.h"
+#include "log.h"
+
+const struct RandrBackend *randr_backend = &x_backend;
+
+/* everything here needs RandR 1.2, complain on stderr if the server lacks it */
+int
+check_server_randr_version (Display *dpy)
+{
+	int major, minor;
+	
+	trace_begin ("XRRQueryVersion", 0);
+	if (!XRRQueryVersion (dpy, &major, &minor)) {
+		fprintf (stderr, "RandR extension missing\n");
+		trace_end ("XRRQueryVersion", 0);
+		return 0;
+	}
+	trace_round_trips (1);
+	trace_end ("XRRQueryVersion", 0);
+	
+	if (major < 1 || (major == 1 && minor < 2)) {
+		fprintf (stderr, "Server RandR version before 1.2\n");
+		return 0;
+	}
+	
+	return 1;
+}
+
+/* 
+ * Build an XRRCrtcInfo from an xcb reply in arena, laid out in one block
+ * like Xlib does. outputs has room for every possible output, so that a
+ * later reply for the same crtc always fits in place (crtc_info_update).
+ */
+static XRRCrtcInfo *
+crtc_info_from_reply (struct Arena *arena, xcb_randr_get_crtc_info_reply_t *reply)
+{
+	XRRCrtcInfo *xci;
+	xcb_randr_output_t *outputs, *possible;
+	int noutput, npossible, room;
+	int i;
+	
+	noutput = xcb_randr_get_crtc_info_outputs_length (reply);
+	npossible = xcb_randr_get_crtc_info_possible_length (reply);
+	outputs = xcb_randr_get_crtc_info_outputs (reply);
+	possible = xcb_randr_get_crtc_info_possible (reply);
+	room = noutput > npossible ? noutput : npossible;
+	
+	xci = arena_alloc (arena, sizeof (XRRCrtcInfo) + 
+							 (room + npossible) * sizeof (RROutput));
+	if (!xci) {
+		return NULL;
+	}
+	
+	xci->timestamp = reply->timestamp;
+	xci->x = reply->x;
+	xci->y = reply->y;
+	xci->width = reply->width;
+	xci->height = reply->height;
+	xci->mode = reply->mode;
+	xci->rotation = reply->rotation;
+	xci->rotations = reply->rotations;
+	xci->noutput = noutput;
+	xci->possible = (RROutput *) (xci + 1);
+	xci->npossible = npossible;
+	xci->outputs = xci->possible + npossible;
+	
+	for (i = 0; i < noutput; i++) {
+		xci->outputs[i] = outputs[i];
+	}
+	for (i = 0; i < npossible; i++) {
+		xci->possible[i] = possible[i];
+	}
+	
+	return xci;
+}
+
+/* same as above for XRROutputInfo */
+static XRROutputInfo *
+output_info_from_reply (struct Arena *arena, xcb_randr_get_output_info_reply_t *reply)
+{
+	XRROutputInfo *xoi;
+	xcb_randr_crtc_t *crtcs;
+	xcb_randr_mode_t *modes;
+	xcb_randr_output_t *clones;
+	int ncrtc, nmode, nclone, name_len;
+	int i;
+	
+	ncrtc = xcb_randr_get_output_info_crtcs_length (reply);
+	nmode = xcb_randr_get_output_info_modes_length (reply);
+	nclone = xcb_randr_get_output_info_clones_length (reply);
+	name_len = xcb_randr_get_output_info_name_length (reply);
+	crtcs = xcb_randr_get_output_info_crtcs (reply);
+	modes = xcb_randr_get_output_info_modes (reply);
+	clones = xcb_randr_get_output_info_clones (reply);
+	
+	xoi = arena_alloc (arena, sizeof (XRROutputInfo) +
+							 ncrtc * sizeof (RRCrtc) +
+							 nmode * sizeof (RRMode) +
+							 nclone * sizeof (RROutput) +
+							 name_len + 1);
+	if (!xoi) {
+		return NULL;
+	}
+	
+	xoi->timestamp = reply->timestamp;
+	xoi->crtc = reply->crtc;
+	xoi->mm_width = reply->mm_width;
+	xoi->mm_height = reply->mm_height;
+	xoi->connection = reply->connection;
+	xoi->subpixel_order = reply->subpixel_order;
+	xoi->ncrtc = ncrtc;
+	xoi->crtcs = (RRCrtc *) (xoi + 1);
+	xoi->nmode = nmode;
+	xoi->npreferred = reply->num_preferred;
+	xoi->modes = (RRMode *) (xoi->crtcs + ncrtc);
+	xoi->nclone = nclone;
+	xoi->clones = (RROutput *) (xoi->modes + nmode);
+	xoi->name = (char *) (xoi->clones + nclone);
+	xoi->nameLen = name_len;
+	
+	for (i = 0; i < ncrtc; i++) {
+		xoi->crtcs[i] = crtcs[i];
+	}
+	for (i = 0; i < nmode; i++) {
+		xoi->modes[i] = modes[i];
+	}
+	for (i = 0; i < nclone; i++) {
+		xoi->clones[i] = clones[i];
+	}
+	memcpy (xoi->name, xcb_randr_get_output_info_name (reply), name_len);
+	xoi->name[name_len] = '\0';
+	
+	return xoi;
+}
+
+/* 
+ * Move an Xlib XRRCrtcInfo into arena, in the layout crtc_info_from_reply ()
+ * uses. The Xlib copy is freed either way, NULL if arena ran out.
+ */
+static XRRCrtcInfo *
+copy_crtc_info (struct Arena *arena, XRRCrtcInfo *info)
+{
+	XRRCrtcInfo *xci;
+	int room;
+	
+	if (!info) {
+		return NULL;
+	}
+	room = info->noutput > info->npossible ? info->noutput : info->npossible;
+	xci = arena_alloc (arena, sizeof (XRRCrtcInfo) + 
+							 (room + info->npossible) * sizeof (RROutput));
+	if (!xci) {
+		XRRFreeCrtcInfo (info);
+		return NULL;
+	}
+	*xci = *info;
+	xci->possible = (RROutput *) (xci + 1);
+	xci->outputs = xci->possible + info->npossible;
+	memcpy (xci->possible, info->possible, info->npossible * sizeof (RROutput));
+	memcpy (xci->outputs, info->outputs, info->noutput * sizeof (RROutput));
+	XRRFreeCrtcInfo (info);
+	
+	return xci;
+}
+
+/* move an Xlib XRROutputInfo into arena, as above */
+static XRROutputInfo *
+copy_output_info (struct Arena *arena, XRROutputInfo *info)
+{
+	XRROutputInfo *xoi;
+	
+	if (!info) {
+		return NULL;
+	}
+	xoi = arena_alloc (arena, sizeof (XRROutputInfo));
+	if (xoi) {
+		*xoi = *info;
+		xoi->crtcs = arena_memdup (arena, info->crtcs, info->ncrtc * sizeof (RRCrtc));
+		xoi->modes = arena_memdup (arena, info->modes, info->nmode * sizeof (RRMode));
+		xoi->clones = arena_memdup (arena, info->clones, info->nclone * sizeof (RROutput));
+		xoi->name = arena_memdup (arena, info->name, info->nameLen + 1);
+		if (!xoi->crtcs || !xoi->modes || !xoi->clones || !xoi->name) {
+			xoi = NULL;
+		}
+	}
+	XRRFreeOutputInfo (info);
+	
+	return xoi;
+}
+
+/* deep copy of res into arena, mode names included; NULL if arena ran out */
+XRRScreenResources *
+screen_resources_dup (struct Arena *arena, const XRRScreenResources *res)
+{
+	XRRScreenResources *copy;
+	int i;
+	
+	copy = arena_alloc (arena, sizeof (XRRScreenResources));
+	if (!copy) {
+		return NULL;
+	}
+	*copy = *res;
+	copy->crtcs = arena_memdup (arena, res->crtcs, res->ncrtc * sizeof (RRCrtc));
+	copy->outputs = arena_memdup (arena, res->outputs, res->noutput * sizeof (RROutput));
+	copy->modes = arena_memdup (arena, res->modes, res->nmode * sizeof (XRRModeInfo));
+	if (!copy->crtcs || !copy->outputs || !copy->modes) {
+		return NULL;
+	}
+	for (i = 0; i < res->nmode; i++) {
+		copy->modes[i].name = arena_memdup (arena, res->modes[i].name, 
+														res->modes[i].nameLength + 1);
+		if (!copy->modes[i].name) {
+			return NULL;
+		}
+	}
+	
+	return copy;
+}
+
+/* move the Xlib screen resources into arena */
+static XRRScreenResources *
+copy_screen_resources (struct Arena *arena, XRRScreenResources *res)
+{
+	XRRScreenResources *copy;
+	
+	copy = screen_resources_dup (arena, res);
+	XRRFreeScreenResources (res);
+	
+	return copy;
+}
+
+/*
+ * Query every crtc and output of the screen resources at once: all the
+ * requests are sent before the first reply is waited for, so the whole
+ * batch costs a single round trip instead of one per crtc and output.
+ * The replies are built in arena. output_infos may be NULL to only
+ * fetch the crtcs. An entry the server answered with an X error stays
+ * NULL: the resources are stale then, and the caller has to read them
+ * again.
+ */
+static void
+x_get_infos (struct ScreenInfo *screen_info, struct Arena *arena,
+				 XRRCrtcInfo **crtc_infos, XRROutputInfo **output_infos)
+{
+	xcb_connection_t *conn;
+	xcb_randr_get_crtc_info_cookie_t *crtc_cookies;
+	xcb_randr_get_output_info_cookie_t *output_cookies;
+	XRRScreenResources *sr;
+	int stale = 0;
+	int i;
+	
+	sr = screen_info->res;
+	conn = XGetXCBConnection (screen_info->dpy);
+	
+	for (i = 0; i < sr->ncrtc; i++) {
+		crtc_infos[i] = NULL;
+	}
+	for (i = 0; output_infos && i < sr->noutput; i++) {
+		output_infos[i] = NULL;
+	}
+	
+	crtc_cookies = malloc (sizeof (xcb_randr_get_crtc_info_cookie_t) * (sr->ncrtc + 1));
+	output_cookies = NULL;
+	if (output_infos) {
+		output_cookies = malloc (sizeof (xcb_randr_get_output_info_cookie_t) * (sr->noutput + 1));
+	}
+	if (!crtc_cookies || (output_infos && !output_cookies)) {
+		log_error ("out of memory for %d crtc and %d output requests", sr->ncrtc, sr->noutput);
+		free (crtc_cookies);
+		free (output_cookies);
+		return;
+	}
+	
+	for (i = 0; i < sr->ncrtc; i++) {
+		crtc_cookies[i] = xcb_randr_get_crtc_info (conn, sr->crtcs[i], 
+																 sr->configTimestamp);
+		trace_async_begin ("crtc_info", sr->crtcs[i]);
+	}
+	for (i = 0; output_infos && i < sr->noutput; i++) {
+		output_cookies[i] = xcb_randr_get_output_info (conn, sr->outputs[i], 
+																	  sr->configTimestamp);
+		trace_async_begin ("output_info", sr->outputs[i]);
+	}
+	screen_info->round_trips++;
+	trace_round_trips (1);
+	
+	for (i = 0; i < sr->ncrtc; i++) {
+		xcb_randr_get_crtc_info_reply_t *reply;
+		xcb_generic_error_t *error = NULL;
+		
+		reply = xcb_randr_get_crtc_info_reply (conn, crtc_cookies[i], &error);
+		trace_async_end ("crtc_info", sr->crtcs[i]);
+		if (error) {
+			log_warn ("crtc 0x%lx: X error %d", sr->crtcs[i], error->error_code);
+			stale = 1;
+		} else if (reply && XCB_RANDR_SET_CONFIG_SUCCESS == reply->status) {
+			crtc_infos[i] = crtc_info_from_reply (arena, reply);
+		}
+		free (error);
+		free (reply);
+	}
+	for (i = 0; output_infos && i < sr->noutput; i++) {
+		xcb_randr_get_output_info_reply_t *reply;
+		xcb_generic_error_t *error = NULL;
+		
+		reply = xcb_randr_get_output_info_reply (conn, output_cookies[i], &error);
+		trace_async_end ("output_info", sr->outputs[i]);
+		if (error) {
+			log_warn ("output 0x%lx: X error %d", sr->outputs[i], error->error_code);
+			stale = 1;
+		} else if (reply && XCB_RANDR_SET_CONFIG_SUCCESS == reply->status) {
+			output_infos[i] = output_info_from_reply (arena, reply);
+		}
+		free (error);
+		free (reply);
+	}
+	
+	free (crtc_cookies);
+	free (output_cookies);
+	
+	/* the blocking requests would only hit the same errors, through Xlib's handler */
+	if (stale) {
+		return;
+	}
+	
+	/* a reply went missing, fall back to the blocking requests */
+	for (i = 0; i < sr->ncrtc; i++) {
+		if (!crtc_infos[i]) {
+			crtc_infos[i] = copy_crtc_info (arena, 
+													  XRRGetCrtcInfo (screen_info->dpy, sr, sr->crtcs[i]));
+			screen_info->round_trips++;
+			trace_round_trips (1);
+		}
+	}
+	for (i = 0; output_infos && i < sr->noutput; i++) {
+		if (!output_infos[i]) {
+			output_infos[i] = copy_output_info (arena, 
+															XRRGetOutputInfo (screen_info->dpy, sr, sr->outputs[i]));
+			screen_info->round_trips++;
+			trace_round_trips (1);
+		}
+	}
+}
+
+static void
+x_get_screen (Display *dpy, Window *root, int *width, int *height,
+				  int *mm_width, int *mm_height)
+{
+	int screen = DefaultScreen (dpy);
+	
+	*root = RootWindow (dpy, screen);
+	*width = DisplayWidth (dpy, screen);
+	*height = DisplayHeight (dpy, screen);
+	*mm_width = DisplayWidthMM (dpy, screen);
+	*mm_height = DisplayHeightMM (dpy, screen);
+}
+
+static void
+x_get_size_range (Display *dpy, Window root, int *min_width, int *min_height,
+						int *max_width, int *max_height)
+{
+	XRRGetScreenSizeRange (dpy, root, min_width, min_height, max_width, max_height);
+	trace_round_trips (1);
+}
+
+static XRRScreenResources *
+x_get_resources (Display *dpy, Window root, int probe, struct Arena *arena)
+{
+	XRRScreenResources *res;
+	
+	if (probe) {
+		res = XRRGetScreenResources (dpy, root);
+	} else {
+		res = XRRGetScreenResourcesCurrent (dpy, root);
+	}
+	trace_round_trips (1);
+	
+	return res ? copy_screen_resources (arena, res) : NULL;
+}
+
+static XRROutputInfo *
+x_get_output_info (Display *dpy, XRRScreenResources *res, RROutput output, 
+						 struct Arena *arena)
+{
+	XRROutputInfo *info;
+	
+	trace_begin ("output_info", output);
+	info = XRRGetOutputInfo (dpy, res, output);
+	trace_round_trips (1);
+	trace_end ("output_info", output);
+	
+	return copy_output_info (arena, info);
+}
+
+static int
+x_select_events (Display *dpy, Window root)
+{
+	int event_base, error_base;
+	
+	if (!XRRQueryExtension (dpy, &event_base, &error_base)) {
+		return -1;
+	}
+	
+	XRRSelectInput (dpy, root,
+						 RRScreenChangeNotifyMask | 
+						 RRCrtcChangeNotifyMask | 
+						 RROutputChangeNotifyMask);
+	
+	return event_base;
+}
+
+static void
+x_grab (Display *dpy)
+{
+	trace_begin ("grab", 0);
+	XGrabServer (dpy);
+	trace_end ("grab", 0);
+}
+
+static void
+x_ungrab (Display *dpy)
+{
+	trace_begin ("ungrab", 0);
+	XUngrabServer (dpy);
+	XSync (dpy, False);
+	trace_round_trips (1);
+	trace_end ("ungrab", 0);
+}
+
+/*
+ * Send every step back to back and only then collect the replies, so
+ * the whole transaction costs one round trip however many crtcs it
+ * touches. The server handles the requests in order, so the disable ->
+ * resize -> set sequence of the plan is preserved. Each reply (or X
+ * error) comes back on the cookie of its own request, which is how a
+ * failure is pinned on its crtc. Returns 1 when every step succeeded.
+ */
+static int
+x_run_plan (struct ModesetPlan *plan)
+{
+	struct ScreenInfo *screen_info = plan->screen_info;
+	xcb_connection_t *conn;
+	xcb_randr_set_crtc_config_cookie_t *crtc_cookies;
+	xcb_void_cookie_t size_cookie;
+	xcb_timestamp_t config_timestamp;
+	int ok = 1;
+	int i;
+	
+	conn = XGetXCBConnection (screen_info->dpy);
+	config_timestamp = screen_info->res->configTimestamp;
+	size_cookie.sequence = 0;
+	crtc_cookies = malloc (sizeof (xcb_randr_set_crtc_config_cookie_t) * 
+								  (plan->n_step ? plan->n_step : 1));
+	if (!crtc_cookies) {
+		log_error ("out of memory for %d modeset requests", plan->n_step);
+		for (i = 0; i < plan->n_step; i++) {
+			plan->steps[i].status = RRSetConfigFailed;
+			plan->steps[i].error_code = Success;
+		}
+		return 0;
+	}
+	
+	for (i = 0; i < plan->n_step; i++) {
+		struct ModesetStep *step = &plan->steps[i];
+		
+		switch (step->type) {
+			case STEP_DISABLE:
+			case STEP_SET_CRTC:
+				crtc_cookies[i] = xcb_randr_set_crtc_config (conn, step->crtc->id, 
+																	  XCB_CURRENT_TIME, config_timestamp,
+																	  step->x, step->y, step->mode_id, 
+																	  step->rotation, 
+																	  step->noutput, step->outputs);
+				trace_async_begin ("crtc_apply", step->crtc->id);
+				break;
+			case STEP_SCREEN_SIZE:
+				size_cookie = xcb_randr_set_screen_size_checked (conn, screen_info->window,
+																				 plan->width, plan->height,
+																				 plan->mmWidth, plan->mmHeight);
+				trace_async_begin ("XRRSetScreenSize", screen_info->window);
+				break;
+		}
+	}
+	xcb_flush (conn);
+	trace_round_trips (1);
+	
+	for (i = 0; i < plan->n_step; i++) {
+		struct ModesetStep *step = &plan->steps[i];
+		xcb_randr_set_crtc_config_reply_t *reply;
+		xcb_generic_error_t *error = NULL;
+		
+		if (STEP_SCREEN_SIZE == step->type) {
+			error = xcb_request_check (conn, size_cookie);
+			step->status = error ? RRSetConfigFailed : RRSetConfigSuccess;
+			trace_async_end ("XRRSetScreenSize", screen_info->window);
+		} else {
+			reply = xcb_randr_set_crtc_config_reply (conn, crtc_cookies[i], &error);
+			step->status = reply ? reply->status : RRSetConfigFailed;
+			free (reply);
+			trace_async_end ("crtc_apply", step->crtc->id);
+		}
+		step->error_code = error ? error->error_code : Success;
+		free (error);
+		
+		if (RRSetConfigSuccess != step->status) {
+			ok = 0;
+		} else if (STEP_SET_CRTC == step->type) {
+			step->crtc->changed = 0;
+		}
+	}
+	
+	free (crtc_cookies);
+	
+	return ok;
+}
+
+const struct RandrBackend x_backend = {
+	"x",
+	x_get_screen,
+	x_get_size_range,
+	x_get_resources,
+	x_get_infos,
+	x_get_output_info,
+	x_select_events,
+	x_grab,
+	x_ungrab,
+	x_run_plan
+};
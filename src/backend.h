@@ -0,0 +1,67 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_BACKEND_H
+#define RANDR_GUI_BACKEND_H
+
+#include <stdio.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+
+#include "arena.h"
+
+struct ScreenInfo;
+struct ModesetPlan;
+
+/* 
+ * Everything the core asks of the server, so that the X server can be
+ * swapped for a synthetic one (mock.c). Replies are built in the arena
+ * given, nothing a backend returns needs freeing on its own.
+ */
+struct RandrBackend {
+	const char *name;
+	
+	/* the root window and the current screen size, in pixels and mm */
+	void (*get_screen) (Display *dpy, Window *root, int *width, int *height,
+							  int *mm_width, int *mm_height);
+	void (*get_size_range) (Display *dpy, Window root, int *min_width, int *min_height,
+									int *max_width, int *max_height);
+	XRRScreenResources *(*get_resources) (Display *dpy, Window root, int probe, 
+													  struct Arena *arena);
+	/* every crtc and output of screen_info->res, output_infos may be NULL */
+	void (*get_infos) (struct ScreenInfo *screen_info, struct Arena *arena,
+							 XRRCrtcInfo **crtc_infos, XRROutputInfo **output_infos);
+	XRROutputInfo *(*get_output_info) (Display *dpy, XRRScreenResources *res, 
+												  RROutput output, struct Arena *arena);
+	/* select RandR events, returns the event base or -1 */
+	int (*select_events) (Display *dpy, Window root);
+	void (*grab) (Display *dpy);
+	void (*ungrab) (Display *dpy);
+	int (*run_plan) (struct ModesetPlan *plan);
+};
+
+extern const struct RandrBackend x_backend;
+extern const struct RandrBackend *randr_backend;
+
+int check_server_randr_version (Display *dpy);
+XRRScreenResources *screen_resources_dup (struct Arena *arena, const XRRScreenResources *res);
+
+#endif
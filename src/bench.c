@@ -0,0 +1,319 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * grandr-bench: times the core paths against generated mock topologies
+ * (see mock.c) of 1, 4, 16 and 64 outputs and writes one JSON record per
+ * path and size, so two builds can be compared with a diff or a script.
+ *
+ *   read_screen_info   a whole snapshot, read and freed
+ *   mode_choices       the list fill_mode_store () shows for one output
+ *   layout_regions     set_positions () with the outputs spread over
+ *                      the five position views
+ *   apply              what apply () does after set_positions (): validate,
+ *                      size the screen and run the modeset
+ *
+ * Each path runs until it has taken --min-ms of wall time. Requests and
+ * round trips are what the mock server counted, per iteration. Leave
+ * $GRANDR_LOG unset, logging would be timed along with the core.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "screen.h"
+#include "layout.h"
+#include "validate.h"
+#include "mock.h"
+
+#define BENCH_MODES		300
+#define BENCH_MIN_MS		200
+#define BENCH_N_REGION	5
+
+static const int bench_sizes[] = { 1, 4, 16, 64 };
+
+static const int region_relation[BENCH_N_REGION] = {
+	LAYOUT_SAME_AS, LAYOUT_LEFT_OF, LAYOUT_RIGHT_OF, LAYOUT_ABOVE, LAYOUT_BELOW
+};
+
+struct BenchState {
+	struct ScreenInfo *screen_info;
+	struct LayoutRegion regions[BENCH_N_REGION];
+	struct ModeEntry **entries;
+	long iteration;
+	int failed;
+};
+
+struct BenchResult {
+	const char *name;
+	int n_output;
+	long iterations;
+	double mean_us, min_us;
+	double requests, round_trips;
+	int failed;
+};
+
+static double
+now_us (void)
+{
+	struct timespec ts;
+	
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void
+usage (void)
+{
+	fprintf (stderr, 
+				"usage: grandr-bench [--out <file>] [--modes <count>] [--min-ms <ms>]\n");
+	exit (1);
+}
+
+static void
+bench_read_screen_info (struct BenchState *state)
+{
+	free_screen_info (read_screen_info (NULL, 0));
+}
+
+static void
+bench_mode_choices (struct BenchState *state)
+{
+	struct ScreenInfo *screen_info = state->screen_info;
+	int active;
+	
+	if (!output_mode_choices (screen_info, &screen_info->outputs[0], state->entries, &active)) {
+		state->failed = 1;
+	}
+}
+
+static void
+bench_layout_regions (struct BenchState *state)
+{
+	if (!layout_solve_regions (state->screen_info, state->regions, BENCH_N_REGION, stderr)) {
+		state->failed = 1;
+	}
+}
+
+/*
+ * Outputs go round robin over the regions, shifted by one region every
+ * iteration so each apply really moves every crtc.
+ */
+static void
+fill_regions (struct BenchState *state, int shift)
+{
+	struct ScreenInfo *screen_info = state->screen_info;
+	int i;
+	
+	for (i = 0; i < BENCH_N_REGION; i++) {
+		state->regions[i].relation = region_relation[i];
+		state->regions[i].n_crtc = 0;
+	}
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct LayoutRegion *region = &state->regions[(i + shift) % BENCH_N_REGION];
+		
+		region->crtcs[region->n_crtc++] = screen_info->outputs[i].cur_crtc;
+	}
+}
+
+static void
+bench_apply (struct BenchState *state)
+{
+	struct ScreenInfo *screen_info = state->screen_info;
+	
+	fill_regions (state, ++state->iteration);
+	if (!layout_solve_regions (screen_info, state->regions, BENCH_N_REGION, stderr) ||
+		 validate_screen_info (screen_info, stderr) ||
+		 !set_screen_size (screen_info) ||
+		 !apply_screen_info (screen_info)) {
+		state->failed = 1;
+	}
+}
+
+/*
+ * 64 monitors at their native size do not fit in the 32768 pixel
+ * coordinate space however they are arranged, XGA on all of them does.
+ */
+static void
+set_small_modes (struct ScreenInfo *screen_info)
+{
+	int i, j;
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct OutputInfo *output = &screen_info->outputs[i];
+		
+		for (j = 0; j < output->n_mode; j++) {
+			struct ModeEntry *entry = &screen_info->mode_db.entries[output->modes[j]];
+			
+			if (1024 == entry->width && 768 == entry->height) {
+				output_set_mode (screen_info, output, entry->id);
+				break;
+			}
+		}
+	}
+}
+
+static void
+run_bench (const char *name, int n_output, void (*op) (struct BenchState *),
+			  struct BenchState *state, double min_ms, struct BenchResult *result)
+{
+	struct MockStats stats;
+	double start, elapsed = 0, t;
+	
+	memset (result, 0, sizeof (struct BenchResult));
+	result->name = name;
+	result->n_output = n_output;
+	result->min_us = -1;
+	state->failed = 0;
+	
+	mock_backend_reset_stats ();
+	while (elapsed < min_ms * 1000 || result->iterations < 3) {
+		start = now_us ();
+		op (state);
+		t = now_us () - start;
+		
+		elapsed += t;
+		result->iterations++;
+		if (result->min_us < 0 || t < result->min_us) {
+			result->min_us = t;
+		}
+	}
+	mock_backend_stats (&stats);
+	
+	result->mean_us = elapsed / result->iterations;
+	result->requests = (double) stats.requests / result->iterations;
+	result->round_trips = (double) stats.round_trips / result->iterations;
+	result->failed = state->failed;
+}
+
+static void
+print_result (FILE *file, struct BenchResult *result, int last)
+{
+	fprintf (file,
+				"    { \"bench\": \"%s\", \"outputs\": %d, \"iterations\": %ld, "
+				"\"mean_us\": %.3f, \"min_us\": %.3f, "
+				"\"requests\": %.2f, \"round_trips\": %.2f, \"ok\": %s }%s\n",
+				result->name, result->n_output, result->iterations,
+				result->mean_us, result->min_us,
+				result->requests, result->round_trips,
+				result->failed ? "false" : "true", last ? "" : ",");
+}
+
+int
+main (int argc, char *argv[])
+{
+	const int n_size = sizeof (bench_sizes) / sizeof (bench_sizes[0]);
+	struct BenchResult *results;
+	struct BenchState state;
+	const char *out_path = "bench.json";
+	FILE *out;
+	double min_ms = BENCH_MIN_MS;
+	int n_mode = BENCH_MODES;
+	int n_result = 0;
+	int failed = 0;
+	int i, j;
+	
+	for (i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		
+		if (strcmp (arg, "--out") == 0 && val) {
+			out_path = val;
+			i++;
+		} else if (strcmp (arg, "--modes") == 0 && val) {
+			n_mode = atoi (val);
+			i++;
+		} else if (strcmp (arg, "--min-ms") == 0 && val) {
+			min_ms = atof (val);
+			i++;
+		} else {
+			usage ();
+		}
+	}
+	if (n_mode < 1) {
+		usage ();
+	}
+	
+	out = strcmp (out_path, "-") == 0 ? stdout : fopen (out_path, "w");
+	if (!out) {
+		fprintf (stderr, "%s: cannot write results\n", out_path);
+		return 1;
+	}
+	
+	randr_backend = &mock_backend;
+	results = calloc (n_size * 4, sizeof (struct BenchResult));
+	
+	for (i = 0; i < n_size; i++) {
+		int n_output = bench_sizes[i];
+		
+		mock_backend_free ();
+		mock_backend_generate (n_output, n_output, n_mode);
+		
+		memset (&state, 0, sizeof (state));
+		run_bench ("read_screen_info", n_output, bench_read_screen_info, 
+					  &state, min_ms, &results[n_result++]);
+		
+		state.screen_info = read_screen_info (NULL, 0);
+		if (!state.screen_info) {
+			fprintf (stderr, "cannot read the mock screen state\n");
+			return 1;
+		}
+		state.entries = malloc (sizeof (struct ModeEntry *) * (n_mode + 1));
+		for (j = 0; j < BENCH_N_REGION; j++) {
+			state.regions[j].crtcs = malloc (sizeof (struct CrtcInfo *) * n_output);
+		}
+		
+		run_bench ("mode_choices", n_output, bench_mode_choices, 
+					  &state, min_ms, &results[n_result++]);
+		
+		fill_regions (&state, 0);
+		run_bench ("layout_regions", n_output, bench_layout_regions, 
+					  &state, min_ms, &results[n_result++]);
+		
+		set_small_modes (state.screen_info);
+		run_bench ("apply", n_output, bench_apply, 
+					  &state, min_ms, &results[n_result++]);
+		
+		for (j = 0; j < BENCH_N_REGION; j++) {
+			free (state.regions[j].crtcs);
+		}
+		free (state.entries);
+		free_screen_info (state.screen_info);
+	}
+	mock_backend_free ();
+	
+	fprintf (out, "{\n  \"modes\": %d,\n  \"min_ms\": %.0f,\n  \"results\": [\n", 
+				n_mode, min_ms);
+	for (i = 0; i < n_result; i++) {
+		print_result (out, &results[i], i == n_result - 1);
+		failed |= results[i].failed;
+	}
+	fprintf (out, "  ]\n}\n");
+	
+	if (out != stdout) {
+		fclose (out);
+	}
+	free (results);
+	
+	return failed;
+}
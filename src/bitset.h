@@ -0,0 +1,101 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_BITSET_H
+#define RANDR_GUI_BITSET_H
+
+/* 
+ * Fixed size bitsets over snapshot indices (crtcs, outputs, modes),
+ * stored as arrays of unsigned long words.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define BITSET_WORD_BITS	(8 * sizeof (unsigned long))
+
+static inline int
+bitset_words (int n_bit)
+{
+	return (n_bit + BITSET_WORD_BITS - 1) / BITSET_WORD_BITS;
+}
+
+/* an empty set with room for n_bit bits */
+static inline unsigned long *
+bitset_new (int n_bit)
+{
+	return calloc (bitset_words (n_bit) ? bitset_words (n_bit) : 1, sizeof (unsigned long));
+}
+
+static inline void
+bitset_set (unsigned long *set, int bit)
+{
+	set[bit / BITSET_WORD_BITS] |= 1UL << (bit % BITSET_WORD_BITS);
+}
+
+static inline void
+bitset_clear (unsigned long *set, int bit)
+{
+	set[bit / BITSET_WORD_BITS] &= ~(1UL << (bit % BITSET_WORD_BITS));
+}
+
+static inline int
+bitset_test (const unsigned long *set, int bit)
+{
+	return (set[bit / BITSET_WORD_BITS] >> (bit % BITSET_WORD_BITS)) & 1;
+}
+
+static inline void
+bitset_fill (unsigned long *set, int n_bit)
+{
+	int i;
+	
+	memset (set, 0, bitset_words (n_bit) * sizeof (unsigned long));
+	for (i = 0; i < n_bit; i++) {
+		bitset_set (set, i);
+	}
+}
+
+static inline void
+bitset_and (unsigned long *dst, const unsigned long *src, int n_bit)
+{
+	int i;
+	
+	for (i = 0; i < bitset_words (n_bit); i++) {
+		dst[i] &= src[i];
+	}
+}
+
+static inline int
+bitset_is_empty (const unsigned long *set, int n_bit)
+{
+	int i;
+	
+	for (i = 0; i < bitset_words (n_bit); i++) {
+		if (set[i]) {
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+#endif
@@ -29,19 +29,18 @@
 #include "interface.h"
 #include "support.h"
 #include "grandr.h"
+#include "log.h"
 
 void
 on_ok_btn_clicked                      (GtkButton       *button,
                                         gpointer         user_data)
 {
-	set_hotkeys();
+	set_hotkeys (&main_widgets);
 	
 	if (!apply (screen_info)) {
 		return;
 	}
 	
-	free_screen_info (screen_info);
-	
 	gtk_widget_destroy (root_window);
 	
 	gtk_main_quit ();
@@ -52,13 +51,13 @@ void
 on_apply_btn_clicked                   (GtkButton       *button,
                                         gpointer         user_data)
 {
-	set_hotkeys();
+	set_hotkeys (&main_widgets);
 	
 	if (!apply (screen_info)) {
 		return;
 	}
 	
-	printf("apply\n");
+	log_info ("applied");
 }
 
 
@@ -66,11 +65,10 @@ void
 on_rotation0_rbtn_pressed              (GtkButton       *button,
                                         gpointer         user_data)
 {
-	GtkImage *rotation_img = GTK_IMAGE (lookup_widget (root_window, "rotation_img"));
-	
-	gtk_image_set_from_icon_name (rotation_img, "gtk-go-up", GTK_ICON_SIZE_BUTTON);
+	gtk_image_set_from_icon_name (main_widgets.rotation_img, "gtk-go-up", GTK_ICON_SIZE_BUTTON);
 	
 	screen_info->cur_crtc->cur_rotation = RR_Rotate_0;
+	check_pending_config (&main_widgets, screen_info);
 }
 
 
@@ -78,11 +76,10 @@ void
 on_rotation90_rbtn_pressed             (GtkButton       *button,
                                         gpointer         user_data)
 {
-	GtkImage *rotation_img = GTK_IMAGE (lookup_widget (root_window, "rotation_img"));
-	
-	gtk_image_set_from_icon_name (rotation_img, "gtk-go-back-ltr", GTK_ICON_SIZE_BUTTON);
+	gtk_image_set_from_icon_name (main_widgets.rotation_img, "gtk-go-back-ltr", GTK_ICON_SIZE_BUTTON);
 	
 	screen_info->cur_crtc->cur_rotation = RR_Rotate_90;
+	check_pending_config (&main_widgets, screen_info);
 }
 
 
@@ -90,11 +87,10 @@ void
 on_rotation180_rbtn_pressed            (GtkButton       *button,
                                         gpointer         user_data)
 {
-	GtkImage *rotation_img = GTK_IMAGE (lookup_widget (root_window, "rotation_img"));
-	
-	gtk_image_set_from_icon_name (rotation_img, "gtk-go-down", GTK_ICON_SIZE_BUTTON);
+	gtk_image_set_from_icon_name (main_widgets.rotation_img, "gtk-go-down", GTK_ICON_SIZE_BUTTON);
 	
 	screen_info->cur_crtc->cur_rotation = RR_Rotate_180;
+	check_pending_config (&main_widgets, screen_info);
 }
 
 
@@ -102,11 +98,10 @@ void
 on_rotation270_rbtn_pressed            (GtkButton       *button,
                                         gpointer         user_data)
 {
-	GtkImage *rotation_img = GTK_IMAGE (lookup_widget (root_window, "rotation_img"));
-	
-	gtk_image_set_from_icon_name (rotation_img, "gtk-go-forward-ltr", GTK_ICON_SIZE_BUTTON);
+	gtk_image_set_from_icon_name (main_widgets.rotation_img, "gtk-go-forward-ltr", GTK_ICON_SIZE_BUTTON);
 	
 	screen_info->cur_crtc->cur_rotation = RR_Rotate_270;
+	check_pending_config (&main_widgets, screen_info);
 }
 
 
@@ -119,8 +114,8 @@ on_output_iview_selection_changed      (GtkIconView     *iconview,
 	GtkTreeIter iter;
 	GList *path_list;
 	GtkTreePath *tree_path;
+	struct OutputInfo *output_info;
 	int output_id;
-	int i;
 	
 	path_list = gtk_icon_view_get_selected_items (iconview);
 	if (g_list_length (path_list) == 0) {
@@ -133,20 +128,19 @@ on_output_iview_selection_changed      (GtkIconView     *iconview,
 
 	gtk_tree_model_get_iter (model,
 			   &iter, tree_path);
+	g_list_foreach (path_list, (GFunc) gtk_tree_path_free, NULL);
+	g_list_free (path_list);
   	gtk_tree_model_get (model, &iter,
 		      COL_OUTPUT_ID, &output_id,
 		      -1);
 		      
-	for (i = 0; i < screen_info->n_output; i++) {
-		if (output_id == screen_info->outputs[i]->id) {
-			screen_info->cur_crtc = screen_info->outputs[i]->cur_crtc;
-			screen_info->cur_output = screen_info->outputs[i];
-			
-			set_basic_views (screen_info->cur_output);
-			set_rotation_views (screen_info->cur_crtc);
-			
-			break;
-		}
+	output_info = get_output_info_by_xid (screen_info, output_id);
+	if (output_info) {
+		screen_info->cur_crtc = output_info->cur_crtc;
+		screen_info->cur_output = output_info;
+		
+		set_basic_views (&main_widgets, screen_info->cur_output);
+		set_rotation_views (&main_widgets, screen_info->cur_crtc);
 	}
 }
 
@@ -167,27 +161,8 @@ on_modes_combo_changed                 (GtkComboBox     *combobox,
 		      COL_MODE_ID, &mode_id,
 		      -1);
       
-	if (screen_info->cur_crtc) {
-		screen_info->cur_crtc->cur_mode_id = mode_id;
-		screen_info->cur_crtc->changed = 1;
-	} else {
-		struct CrtcInfo *crtc_info;
-		
-		crtc_info = auto_find_crtc (screen_info, screen_info->cur_output);
-		if (!crtc_info) {
-#if RANDR_GUI_DEBUG
-			fprintf (stderr, "Can not find usable CRTC\n");
-#endif
-			return;
-		} else {
-			screen_info->cur_output->cur_crtc = crtc_info;
-			screen_info->cur_crtc = crtc_info;
-			screen_info->cur_crtc->cur_noutput++;
-			fprintf (stderr, "n output: %d\n", screen_info->cur_crtc->cur_noutput);
-			screen_info->cur_crtc->cur_mode_id = mode_id;
-			screen_info->cur_crtc->changed = 1;
-		}
-	}
+	output_set_mode (screen_info, screen_info->cur_output, mode_id);
+	check_pending_config (&main_widgets, screen_info);
 }
 
 
@@ -195,8 +170,7 @@ void
 on_clone_rbtn_pressed                  (GtkButton       *button,
                                         gpointer         user_data)
 {
-	screen_info->clone = 1;
-	//set_output_layout (screen_info);
+	set_clone_layout (&main_widgets, screen_info);
 }
 
 
@@ -205,7 +179,6 @@ on_panorama_rbtn_pressed               (GtkButton       *button,
                                         gpointer         user_data)
 {
 	screen_info->clone = 0;
-	//set_output_layout (screen_info);
 }
 
 
@@ -252,6 +225,8 @@ on_iview_drag_data_get                 (GtkWidget       *widget,
 
 	gtk_tree_model_get_iter (model,
 			   &iter, tree_path);
+	g_list_foreach (path_list, (GFunc) gtk_tree_path_free, NULL);
+	g_list_free (path_list);
   	gtk_tree_model_get (model, &iter,
 		      COL_OUTPUT_ID, &output_id,
 		      -1);
@@ -287,7 +262,7 @@ on_iview_drag_data_received            (GtkWidget       *widget,
 		//return;
 	}
 	
-	output_pixbuf = randr_create_pixbuf (small_pixbuf);
+	output_pixbuf = randr_ref_pixbuf (small_pixbuf);
 	output_id = (int) *data->data;
 	output_name = get_output_name (screen_info, output_id);
 	
@@ -298,6 +273,8 @@ on_iview_drag_data_received            (GtkWidget       *widget,
 									COL_OUTPUT_NAME, output_name,
 									COL_OUTPUT_PIXBUF, output_pixbuf,
 									-1);
+	g_object_unref (output_pixbuf);
+	check_pending_config (&main_widgets, screen_info);
 }
 
 
@@ -305,11 +282,11 @@ void
 on_auto_cbtn_toggled                   (GtkToggleButton *togglebutton,
                                         gpointer         user_data)
 {
-	GtkWidget *mode_combo;
-	GtkWidget *off_cbtn;
-	
-	mode_combo = lookup_widget (root_window, MODE_COMBO_NAME);
-	off_cbtn = lookup_widget (root_window, OFF_CHECKBUTTON_NAME);
+	GtkWidget *mode_combo = GTK_WIDGET (main_widgets.modes_combo);
+	GtkWidget *off_cbtn = GTK_WIDGET (main_widgets.off_cbtn);
+	GtkWidget *dialog;
+	int reloaded = 0;
+	int ok;
 	
 	if (gtk_toggle_button_get_active (togglebutton)) {
 		gtk_widget_set_sensitive (mode_combo, FALSE);
@@ -318,8 +295,33 @@ on_auto_cbtn_toggled                   (GtkToggleButton *togglebutton,
 		screen_info->cur_output->auto_set = 1;
 		screen_info->cur_output->off_set = 0;
 		
-		output_auto (screen_info, screen_info->cur_output);
+		ok = output_auto (screen_info, screen_info->cur_output);
+		if (ok < 0) {
+			/* probing found new modes: reread everything, then try again */
+			reload_screen_info ();
+			reloaded = 1;
+			screen_info->cur_output->auto_set = 1;
+			ok = output_auto (screen_info, screen_info->cur_output);
+		}
+		if (ok <= 0) {
+			/* leave the output as it was, with the mode list back in reach */
+			screen_info->cur_output->auto_set = 0;
+			dialog = gtk_message_dialog_new (GTK_WINDOW(root_window),
+				  	  GTK_DIALOG_DESTROY_WITH_PARENT | GTK_DIALOG_MODAL,
+					  GTK_MESSAGE_WARNING,
+					  GTK_BUTTONS_CANCEL,
+					  ok < 0 ? _("The outputs changed while probing, try again\n")
+							 : _("No usable mode found for this output\n")
+					  );
+			gtk_dialog_run (GTK_DIALOG (dialog));
+			gtk_widget_destroy (dialog);
+		}
+		if (reloaded || ok <= 0) {
+			set_basic_views (&main_widgets, screen_info->cur_output);
+			set_rotation_views (&main_widgets, screen_info->cur_crtc);
+		}
 		//screen_info->cur_crtc->changed = 1;
+		check_pending_config (&main_widgets, screen_info);
 		
 	} else {
 		if (!gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(off_cbtn))) {
@@ -333,11 +335,8 @@ void
 on_off_cbtn_toggled                    (GtkToggleButton *togglebutton,
                                         gpointer         user_data)
 {
-	GtkWidget *mode_combo;
-	GtkWidget *auto_cbtn;
-	
-	mode_combo = lookup_widget (root_window, MODE_COMBO_NAME);
-	auto_cbtn = lookup_widget (root_window, AUTO_CHECKBUTTON_NAME);
+	GtkWidget *mode_combo = GTK_WIDGET (main_widgets.modes_combo);
+	GtkWidget *auto_cbtn = GTK_WIDGET (main_widgets.auto_cbtn);
 	
 	if (gtk_toggle_button_get_active (togglebutton)) {
 		gtk_widget_set_sensitive (mode_combo, FALSE);
@@ -348,6 +347,7 @@ on_off_cbtn_toggled                    (GtkToggleButton *togglebutton,
 		
 		output_off (screen_info, screen_info->cur_output); 
 		//screen_info->cur_crtc->changed = 1;
+		check_pending_config (&main_widgets, screen_info);
 		
 	} else {
 		if (!gtk_toggle_button_get_active (GTK_TOGGLE_BUTTON(auto_cbtn))) {
@@ -361,9 +361,7 @@ void
 on_hotkey_cbtn_toggled                 (GtkToggleButton *togglebutton,
                                         gpointer         user_data)
 {
-	GtkWidget *hotkey_tview;
-	
-	hotkey_tview = lookup_widget (root_window, HOTKEY_TREEVIEW_NAME);
+	GtkWidget *hotkey_tview = GTK_WIDGET (main_widgets.hotkey_tview);
 
 	if (gtk_toggle_button_get_active (togglebutton)) {
 		gtk_widget_set_sensitive (hotkey_tview, TRUE);
@@ -0,0 +1,331 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * grandr-cli: the RandR core of grandr without any GTK, for scripts and
+ * hotplug hooks that just want to query or set a layout and exit.
+ * With --daemon it stays resident; later invocations then hand their
+ * request to it instead of reading the screen state again.
+ * With $GRANDR_MOCK set it runs against a synthetic server instead, see
+ * mock.c, and reports what the requests would have cost.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "screen.h"
+#include "request.h"
+#include "daemon.h"
+#include "backend.h"
+#include "mock.h"
+#include "trace.h"
+#include "log.h"
+
+/* RSS growth over a soak run still put down to allocator noise */
+#define SOAK_SLACK_KB	256
+
+static void
+usage (void)
+{
+	fprintf (stderr, 
+				"usage: grandr-cli [--display <display>] [--trace <file>] [--probe] --query\n"
+				"       grandr-cli [--display <display>] [--probe]\n"
+				"                  --output <name> [--auto | --off | --clone [<group>] | --mode <mode> [--rate <Hz>]]\n"
+				"                                  [--pos <x>x<y>] [--rotate normal|left|inverted|right]\n"
+				"                                  [--left-of | --right-of | --above | --below | --same-as <name>]\n"
+				"                  [--output <name> ...]\n"
+				"       grandr-cli [--display <display>] [--probe] --soak <count>\n"
+				"       grandr-cli [--display <display>] --daemon\n"
+				"       grandr-cli [--display <display>] --send <request>\n");
+	exit (1);
+}
+
+/* resident set size in kB, 0 where /proc is not available */
+static long
+resident_kb (void)
+{
+	FILE *statm;
+	long size, resident = 0;
+	
+	statm = fopen ("/proc/self/statm", "r");
+	if (!statm) {
+		return 0;
+	}
+	if (fscanf (statm, "%ld %ld", &size, &resident) != 2) {
+		resident = 0;
+	}
+	fclose (statm);
+	
+	return resident * (sysconf (_SC_PAGESIZE) / 1024);
+}
+
+/*
+ * Read and free the screen state count times, the way a resident
+ * process keeps refreshing it, and check the RSS does not grow.
+ */
+static int
+soak (Display *display, int probe, int count)
+{
+	long start_kb = 0, end_kb;
+	int i;
+	
+	for (i = 0; i < count; i++) {
+		struct ScreenInfo *screen_info = read_screen_info (display, probe);
+		
+		if (!screen_info) {
+			fprintf (stderr, "cannot read the screen state\n");
+			return 0;
+		}
+		free_screen_info (screen_info);
+		/* the first rounds warm up Xlib and malloc, measure from there */
+		if (i == count / 10) {
+			start_kb = resident_kb ();
+		}
+	}
+	end_kb = resident_kb ();
+	
+	printf ("soak: %d snapshots, rss %ld kB -> %ld kB\n", count, start_kb, end_kb);
+	
+	return end_kb - start_kb <= SOAK_SLACK_KB;
+}
+
+/* hand the request to a running daemon, -1 if there is none */
+static int
+send_to_daemon (const char *display_name, int argc, char **argv, int do_query)
+{
+	char *request;
+	size_t size = 16;
+	int ret = 1;
+	int i;
+	
+	for (i = 0; i < argc; i++) {
+		size += strlen (argv[i]) + 1;
+	}
+	request = malloc (size);
+	strcpy (request, "apply");
+	for (i = 0; i < argc; i++) {
+		strcat (request, " ");
+		strcat (request, argv[i]);
+	}
+	
+	if (argc) {
+		ret = daemon_request (display_name, request, stderr);
+	}
+	if (ret > 0 && do_query) {
+		ret = daemon_request (display_name, "dump", stdout);
+	}
+	free (request);
+	
+	return ret;
+}
+
+/* apply reqs, rereading the snapshot once if probing found new modes */
+static int
+apply_requests (Display *display, struct ScreenInfo **screen_info, 
+					 struct OutputRequest *reqs, int n_req)
+{
+	int ok;
+	
+	ok = apply_output_requests (*screen_info, reqs, n_req, stderr);
+	if (ok < 0) {
+		struct ScreenInfo *new_info = read_screen_info (display, 0);
+		
+		if (!new_info) {
+			return 0;
+		}
+		free_screen_info (*screen_info);
+		*screen_info = new_info;
+		ok = apply_output_requests (*screen_info, reqs, n_req, stderr);
+	}
+	
+	return ok > 0;
+}
+
+/* the same as main () below, without a display */
+static int
+run_mock (struct OutputRequest *reqs, int n_req, int do_query, int probe, int soak_count)
+{
+	struct ScreenInfo *screen_info;
+	struct MockStats stats;
+	int ret = 0;
+	
+	if (soak_count > 0) {
+		ret = soak (NULL, probe, soak_count) ? 0 : 1;
+	} else {
+		screen_info = read_screen_info (NULL, probe);
+		if (!screen_info) {
+			fprintf (stderr, "cannot read the screen state\n");
+			ret = 1;
+		} else {
+			if (n_req && !apply_requests (NULL, &screen_info, reqs, n_req)) {
+				ret = 1;
+			}
+			if (do_query) {
+				print_screen_info (screen_info, stdout);
+			}
+			free_screen_info (screen_info);
+		}
+	}
+	
+	mock_backend_stats (&stats);
+	fprintf (stderr, "mock: %ld requests, %ld round trips, %.3f ms simulated latency\n",
+				stats.requests, stats.round_trips, stats.latency_ms);
+	mock_backend_free ();
+	
+	return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+	Display *display;
+	struct ScreenInfo *screen_info;
+	struct OutputRequest *reqs;
+	const char *display_name = NULL;
+	const char *send = NULL;
+	char **out_args;
+	int n_out_arg = 0;
+	int n_req = 0;
+	int do_query = 0;
+	int do_daemon = 0;
+	int soak_count = 0;
+	int probe = 0;
+	int ret = 0;
+	int i;
+	
+	if (!mock_backend_init (stderr)) {
+		return 1;
+	}
+	
+	out_args = calloc (argc, sizeof (char *));
+	
+	for (i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		
+		if (strcmp (arg, "--query") == 0) {
+			do_query = 1;
+		} else if (strcmp (arg, "--probe") == 0) {
+			probe = 1;
+		} else if (strcmp (arg, "--daemon") == 0) {
+			do_daemon = 1;
+		} else if (strcmp (arg, "--soak") == 0 && val) {
+			soak_count = atoi (val);
+			i++;
+		} else if (strcmp (arg, "--send") == 0 && val) {
+			send = val;
+			i++;
+		} else if (strcmp (arg, "--display") == 0 && val) {
+			display_name = val;
+			i++;
+		} else if (strcmp (arg, "--trace") == 0 && val) {
+			trace_init (val);
+			i++;
+		} else {
+			out_args[n_out_arg++] = argv[i];
+		}
+	}
+	
+	trace_init (NULL);
+	log_init ();
+	
+	reqs = calloc (argc, sizeof (struct OutputRequest));
+	n_req = parse_output_requests (n_out_arg, out_args, reqs, stderr);
+	if (n_req < 0) {
+		usage ();
+	}
+	
+	if (send) {
+		ret = daemon_request (display_name, send, stdout);
+		if (ret < 0) {
+			fprintf (stderr, "no daemon running for %s\n", XDisplayName (display_name));
+		}
+		return ret > 0 ? 0 : 1;
+	}
+	
+	if (!do_query && !n_req && !do_daemon && soak_count <= 0) {
+		usage ();
+	}
+	
+	if (&mock_backend == randr_backend) {
+		if (do_daemon) {
+			fprintf (stderr, "--daemon needs a real X server\n");
+			return 1;
+		}
+		ret = run_mock (reqs, n_req, do_query, probe, soak_count);
+		free (reqs);
+		free (out_args);
+		return ret;
+	}
+	
+	/* a running daemon already holds the state, skip reading it again */
+	if (!do_daemon && !probe && soak_count <= 0) {
+		ret = send_to_daemon (display_name, n_out_arg, out_args, do_query);
+		if (ret >= 0) {
+			return ret > 0 ? 0 : 1;
+		}
+		ret = 0;
+	}
+	
+	trace_begin ("x_connect", 0);
+	display = XOpenDisplay (display_name);
+	trace_round_trips (1);
+	trace_end ("x_connect", 0);
+	if (!display) {
+		fprintf (stderr, "Can't open display %s\n", XDisplayName (display_name));
+		return 1;
+	}
+	if (!check_server_randr_version (display)) {
+		return 1;
+	}
+	
+	if (do_daemon) {
+		ret = run_daemon (display) ? 0 : 1;
+		XCloseDisplay (display);
+		return ret;
+	}
+	
+	if (soak_count > 0) {
+		ret = soak (display, probe, soak_count) ? 0 : 1;
+		XCloseDisplay (display);
+		return ret;
+	}
+	
+	screen_info = read_screen_info (display, probe);
+	if (!screen_info) {
+		fprintf (stderr, "cannot read the screen state\n");
+		ret = 1;
+	} else {
+		if (n_req && !apply_requests (display, &screen_info, reqs, n_req)) {
+			ret = 1;
+		}
+		if (do_query) {
+			print_screen_info (screen_info, stdout);
+		}
+		free_screen_info (screen_info);
+	}
+	free (reqs);
+	free (out_args);
+	XCloseDisplay (display);
+	
+	return ret;
+}
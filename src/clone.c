@@ -0,0 +1,431 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * Clone mode: show the same picture on a set of outputs. The common
+ * resolution is found by intersecting per-output bitsets of resolutions,
+ * then the outputs are packed onto as few crtcs as their common modes,
+ * crtcs and clone masks allow.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "clone.h"
+#include "bitset.h"
+#include "log.h"
+
+/* one crtc's worth of cloned outputs */
+struct CloneGroup {
+	unsigned long *modes;		/* modes (by index) all members have, of the clone size */
+	unsigned long *crtcs;		/* crtcs all members can use */
+	unsigned long *clones;		/* outputs all members can clone */
+	struct OutputInfo **outputs;
+	int n_output;
+};
+
+/* 
+ * Number the distinct resolutions, size_of[mode index] = resolution
+ * number. mode_db sorts by resolution, so equal sizes are adjacent.
+ */
+static int
+index_mode_sizes (struct ModeDb *mode_db, int *size_of)
+{
+	struct ModeEntry *prev = NULL;
+	int n_size = 0;
+	int i;
+	
+	for (i = 0; i < mode_db->n_mode; i++) {
+		struct ModeEntry *entry = &mode_db->entries[mode_db->sorted[i]];
+		
+		if (prev && (prev->width != entry->width || prev->height != entry->height)) {
+			n_size++;
+		}
+		size_of[mode_db->sorted[i]] = n_size;
+		prev = entry;
+	}
+	
+	return prev ? n_size + 1 : 0;
+}
+
+static XRRModeInfo *
+native_mode (struct ScreenInfo *screen_info, struct OutputInfo *output)
+{
+	if (output->info->npreferred < 1) {
+		return NULL;
+	}
+	return find_mode_by_xid (screen_info, output->info->modes[0]);
+}
+
+/*
+ * The best resolution every output has: the native size of the most
+ * outputs, then the largest, then the one with the fastest mode. -1 if
+ * there is none, -2 if memory ran out.
+ */
+static int
+pick_clone_size (struct ScreenInfo *screen_info, struct OutputInfo **outputs, int n_output,
+					  int *size_of, int n_size)
+{
+	XRRScreenResources *res = screen_info->res;
+	unsigned long *common, *sizes;
+	XRRModeInfo **sample;
+	int *natives;
+	double *refresh;
+	int best = -1;
+	int i, j;
+	
+	common = bitset_new (n_size);
+	sizes = bitset_new (n_size);
+	sample = calloc (n_size + 1, sizeof (XRRModeInfo *));
+	natives = calloc (n_size + 1, sizeof (int));
+	refresh = calloc (n_size + 1, sizeof (double));
+	if (!common || !sizes || !sample || !natives || !refresh) {
+		best = -2;
+		goto out;
+	}
+	bitset_fill (common, n_size);
+	
+	for (i = 0; i < res->nmode; i++) {
+		sample[size_of[i]] = &res->modes[i];
+		if (screen_info->mode_db.entries[i].refresh > refresh[size_of[i]]) {
+			refresh[size_of[i]] = screen_info->mode_db.entries[i].refresh;
+		}
+	}
+	
+	for (i = 0; i < n_output; i++) {
+		XRRModeInfo *native = native_mode (screen_info, outputs[i]);
+		
+		for (j = 0; j < bitset_words (n_size); j++) {
+			sizes[j] = 0;
+		}
+		for (j = 0; j < res->nmode; j++) {
+			if (bitset_test (outputs[i]->mode_mask, j)) {
+				bitset_set (sizes, size_of[j]);
+			}
+		}
+		bitset_and (common, sizes, n_size);
+		
+		if (native) {
+			natives[size_of[native - res->modes]]++;
+		}
+	}
+	
+	for (i = 0; i < n_size; i++) {
+		long area, best_area;
+		
+		if (!bitset_test (common, i)) {
+			continue;
+		}
+		if (best < 0) {
+			best = i;
+			continue;
+		}
+		if (natives[i] != natives[best]) {
+			if (natives[i] > natives[best]) {
+				best = i;
+			}
+			continue;
+		}
+		area = (long) sample[i]->width * sample[i]->height;
+		best_area = (long) sample[best]->width * sample[best]->height;
+		if (area != best_area) {
+			if (area > best_area) {
+				best = i;
+			}
+			continue;
+		}
+		if (refresh[i] > refresh[best]) {
+			best = i;
+		}
+	}
+	
+out:
+	free (common);
+	free (sizes);
+	free (sample);
+	free (natives);
+	free (refresh);
+	
+	return best;
+}
+
+/* can output join group: a shared mode, a shared crtc and mutual clones */
+static int
+group_accepts (struct ScreenInfo *screen_info, struct CloneGroup *group, 
+					struct OutputInfo *output, int output_index, unsigned long *scratch)
+{
+	XRRScreenResources *res = screen_info->res;
+	int i;
+	
+	if (!bitset_test (group->clones, output_index)) {
+		return 0;
+	}
+	for (i = 0; i < group->n_output; i++) {
+		if (!bitset_test (output->clone_mask, 
+								xid_hash_lookup (&screen_info->output_hash, group->outputs[i]->id))) {
+			return 0;
+		}
+	}
+	
+	for (i = 0; i < bitset_words (screen_info->n_crtc); i++) {
+		scratch[i] = group->crtcs[i] & output->crtc_mask[i];
+	}
+	if (bitset_is_empty (scratch, screen_info->n_crtc)) {
+		return 0;
+	}
+	for (i = 0; i < bitset_words (res->nmode); i++) {
+		scratch[i] = group->modes[i] & output->mode_mask[i];
+	}
+	
+	return !bitset_is_empty (scratch, res->nmode);
+}
+
+/* the wanted mode (by index, -1 for none) if the group has it, else its fastest common mode */
+static XRRModeInfo *
+group_mode (struct ScreenInfo *screen_info, struct CloneGroup *group, int wanted)
+{
+	struct ModeDb *mode_db = &screen_info->mode_db;
+	struct ModeEntry *best = NULL;
+	int i;
+	
+	if (wanted >= 0 && bitset_test (group->modes, wanted)) {
+		return mode_db->entries[wanted].info;
+	}
+	for (i = 0; i < mode_db->n_mode; i++) {
+		if (bitset_test (group->modes, i) &&
+			 (!best || mode_db->entries[i].refresh > best->refresh)) {
+			best = &mode_db->entries[i];
+		}
+	}
+	
+	return best ? best->info : NULL;
+}
+
+/* the index of mode_id if every output has it, -1 otherwise */
+static int
+common_mode (struct ScreenInfo *screen_info, struct OutputInfo **outputs, int n_output,
+				 RRMode mode_id)
+{
+	int index;
+	int i;
+	
+	if (None == mode_id) {
+		return -1;
+	}
+	index = xid_hash_lookup (&screen_info->mode_hash, mode_id);
+	if (index < 0) {
+		return -1;
+	}
+	for (i = 0; i < n_output; i++) {
+		if (!bitset_test (outputs[i]->mode_mask, index)) {
+			return -1;
+		}
+	}
+	
+	return index;
+}
+
+static int
+no_memory (FILE *err)
+{
+	if (err) {
+		fprintf (err, "out of memory\n");
+	}
+	
+	return 0;
+}
+
+/*
+ * Make outputs show the same picture at 0,0. Outputs are packed onto as
+ * few crtcs as possible. If every output has mode_id, that is the picture;
+ * otherwise (or for None) each crtc runs the fastest mode its outputs
+ * share at the best common resolution. Returns 0 after reporting on err
+ * if the outputs have no resolution in common or run out of crtcs, with
+ * the pending state as it was before the call.
+ */
+int
+clone_outputs (struct ScreenInfo *screen_info, 
+					struct OutputInfo **outputs, int n_output, RRMode mode_id, FILE *err)
+{
+	XRRScreenResources *res = screen_info->res;
+	struct CloneGroup *groups = NULL;
+	struct OutputInfo *saved_outputs;
+	struct CrtcInfo *saved_cur_crtc;
+	unsigned long *size_modes = NULL, *scratch = NULL;
+	int *size_of;
+	int n_size, size;
+	int wanted;
+	int n_group = 0;
+	int ok = 1;
+	int i, g;
+	
+	if (n_output < 1) {
+		return 1;
+	}
+	
+	size_of = malloc (sizeof (int) * (res->nmode + 1));
+	if (!size_of) {
+		return no_memory (err);
+	}
+	n_size = index_mode_sizes (&screen_info->mode_db, size_of);
+	wanted = common_mode (screen_info, outputs, n_output, mode_id);
+	if (wanted >= 0) {
+		size = size_of[wanted];
+	} else {
+		if (mode_id != None) {
+			log_debug ("clone: mode 0x%lx is not common to all outputs, picking one", mode_id);
+		}
+		size = pick_clone_size (screen_info, outputs, n_output, size_of, n_size);
+	}
+	if (size < 0) {
+		if (size == -1 && err) {
+			fprintf (err, "the outputs have no resolution in common\n");
+		}
+		ok = size == -1 ? 0 : no_memory (err);
+		goto out;
+	}
+	
+	size_modes = bitset_new (res->nmode);
+	scratch = bitset_new (res->nmode > screen_info->n_crtc ? res->nmode : screen_info->n_crtc);
+	groups = calloc (n_output, sizeof (struct CloneGroup));
+	if (!size_modes || !scratch || !groups) {
+		ok = no_memory (err);
+		goto out;
+	}
+	for (i = 0; i < res->nmode; i++) {
+		if (size_of[i] == size) {
+			bitset_set (size_modes, i);
+		}
+	}
+	
+	for (i = 0; i < n_output; i++) {
+		struct OutputInfo *output = outputs[i];
+		int index = xid_hash_lookup (&screen_info->output_hash, output->id);
+		struct CloneGroup *group = NULL;
+		
+		for (g = 0; g < n_group; g++) {
+			if (group_accepts (screen_info, &groups[g], output, index, scratch)) {
+				group = &groups[g];
+				break;
+			}
+		}
+		
+		if (!group) {
+			group = &groups[n_group++];
+			group->modes = bitset_new (res->nmode);
+			group->crtcs = bitset_new (screen_info->n_crtc);
+			group->clones = bitset_new (screen_info->n_output);
+			group->outputs = malloc (sizeof (struct OutputInfo *) * n_output);
+			if (!group->modes || !group->crtcs || !group->clones || !group->outputs) {
+				ok = no_memory (err);
+				goto out;
+			}
+			memcpy (group->modes, size_modes, bitset_words (res->nmode) * sizeof (unsigned long));
+			bitset_fill (group->crtcs, screen_info->n_crtc);
+			bitset_fill (group->clones, screen_info->n_output);
+		}
+		
+		bitset_and (group->modes, output->mode_mask, res->nmode);
+		bitset_and (group->crtcs, output->crtc_mask, screen_info->n_crtc);
+		bitset_and (group->clones, output->clone_mask, screen_info->n_output);
+		group->outputs[group->n_output++] = output;
+	}
+	
+	/* only the outputs and the crtcs change, keep them to roll back to */
+	saved_outputs = malloc (sizeof (struct OutputInfo) * n_output);
+	if (!saved_outputs) {
+		ok = no_memory (err);
+		goto out;
+	}
+	for (i = 0; i < n_output; i++) {
+		saved_outputs[i] = *outputs[i];
+	}
+	memcpy (screen_info->saved_crtcs, screen_info->crtcs, 
+			  sizeof (struct CrtcInfo) * screen_info->n_crtc);
+	saved_cur_crtc = screen_info->cur_crtc;
+	
+	/* start from a clean slate so every group can find a free crtc */
+	for (i = 0; i < n_output; i++) {
+		output_off (screen_info, outputs[i]);
+	}
+	
+	for (g = 0; g < n_group && ok; g++) {
+		struct CloneGroup *group = &groups[g];
+		XRRModeInfo *mode_info = group_mode (screen_info, group, wanted);
+		struct CrtcInfo *crtc_info;
+		
+		if (!mode_info) {
+			if (err) {
+				fprintf (err, "%s: no mode of the clone resolution\n", group->outputs[0]->info->name);
+			}
+			ok = 0;
+			break;
+		}
+		if (!output_set_mode (screen_info, group->outputs[0], mode_info->id)) {
+			if (err) {
+				fprintf (err, "%s: no crtc left to clone on\n", group->outputs[0]->info->name);
+			}
+			ok = 0;
+			break;
+		}
+		
+		crtc_info = group->outputs[0]->cur_crtc;
+		crtc_info->cur_x = 0;
+		crtc_info->cur_y = 0;
+		crtc_info->cur_rotation = RR_Rotate_0;
+		for (i = 1; i < group->n_output; i++) {
+			group->outputs[i]->cur_crtc = crtc_info;
+			group->outputs[i]->off_set = 0;
+			crtc_info->cur_noutput++;
+		}
+		
+		log_debug ("clone: %d output(s) on crtc 0x%lx at %s", 
+					  group->n_output, crtc_info->id, mode_info->name);
+	}
+	
+	if (ok) {
+		if (screen_info->cur_output) {
+			screen_info->cur_crtc = screen_info->cur_output->cur_crtc;
+		}
+		screen_info->clone = 1;
+	} else {
+		for (i = 0; i < n_output; i++) {
+			*outputs[i] = saved_outputs[i];
+		}
+		memcpy (screen_info->crtcs, screen_info->saved_crtcs, 
+				  sizeof (struct CrtcInfo) * screen_info->n_crtc);
+		screen_info->cur_crtc = saved_cur_crtc;
+	}
+	free (saved_outputs);
+	
+out:
+	for (g = 0; g < n_group; g++) {
+		free (groups[g].modes);
+		free (groups[g].crtcs);
+		free (groups[g].clones);
+		free (groups[g].outputs);
+	}
+	free (groups);
+	free (size_modes);
+	free (scratch);
+	free (size_of);
+	
+	return ok;
+}
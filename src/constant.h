@@ -23,6 +23,7 @@
 #define RANDR_GUI_CONSTANT_H
 
 /* widget name */
+#define OUTPUT_ICONVIEW_NAME		"output_iview"
 #define CENTER_ICONVIEW_NAME		"center_iview"
 #define LEFT_ICONVIEW_NAME		"left_iview"
 #define RIGHT_ICONVIEW_NAME		"right_iview"
@@ -34,6 +35,10 @@
 #define SETTING_NOTEBOOK_NAME	"setting_notebook"
 #define HOTKEY_CHECKBUTTON_NAME	"hotkey_cbtn"
 #define HOTKEY_TREEVIEW_NAME		"hotkey_tview"
+#define OK_BUTTON_NAME			"ok_btn"
+#define APPLY_BUTTON_NAME			"apply_btn"
+#define ROTATION_RADIOBUTTON_NAME	"rotation0_rbtn"
+#define ROTATION_IMAGE_NAME		"rotation_img"
 
 #define OUTPUT_CONNECTED			(1 << 0)
 #define OUTPUT_UNKNOWN				(1 << 1)
@@ -41,6 +46,20 @@
 #define OUTPUT_ON					(1 << 3)
 #define OUTPUT_ALL					(0xf)
 
+/* what a RandR event changed, see screen_info_handle_event () */
+#define SCREEN_EVENT_SIZE			(1 << 0)
+#define SCREEN_EVENT_CRTC			(1 << 1)
+#define SCREEN_EVENT_OUTPUT		(1 << 2)
+#define SCREEN_EVENT_STALE			(1 << 3)
+
+/* problems found by validate_screen_info () */
+#define INVALID_MODE				(1 << 0)
+#define INVALID_CRTC				(1 << 1)
+#define INVALID_CLONE				(1 << 2)
+#define INVALID_ROTATION			(1 << 3)
+#define INVALID_SIZE				(1 << 4)
+#define INVALID_OVERLAP			(1 << 5)
+
 /*Hot Key*/
 #define APP_NAME					"grandr"
 #define GCONF_KEY1 				"/apps/metacity/global_keybindings/run_command_1"
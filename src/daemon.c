@@ -0,0 +1,638 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#define _GNU_SOURCE		/* struct ucred */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+
+#include "screen.h"
+#include "request.h"
+#include "validate.h"
+#include "assign.h"
+#include "daemon.h"
+#include "trace.h"
+#include "log.h"
+
+#define DAEMON_MAX_REQUEST 4096
+
+struct Daemon {
+	Display *dpy;
+	struct ScreenInfo *screen_info;
+	int listen_fd;
+	int cycle;			/* next built-in layout */
+};
+
+static volatile sig_atomic_t daemon_quit = 0;
+
+/*
+ * One socket per user and display, in the private runtime directory. There
+ * is no daemon without one: anybody can plant a socket under /tmp. Returns
+ * NULL then.
+ */
+char *
+daemon_socket_path (const char *display_name)
+{
+	const char *dir;
+	char *path, *p;
+	size_t size;
+	
+	dir = getenv ("XDG_RUNTIME_DIR");
+	if (!dir || !*dir) {
+		return NULL;
+	}
+	display_name = XDisplayName (display_name);
+	
+	size = strlen (dir) + strlen (display_name) + 32;
+	path = malloc (size);
+	if (!path) {
+		return NULL;
+	}
+	snprintf (path, size, "%s/grandr-%u-%s.sock", dir, (unsigned) getuid (), display_name);
+	
+	for (p = path + strlen (dir) + 1; *p; p++) {
+		if (*p == '/') {
+			*p = '_';
+		}
+	}
+	
+	return path;
+}
+
+/* is the process at the other end of fd running as us? */
+static int
+daemon_peer_trusted (int fd)
+{
+#ifdef SO_PEERCRED
+	struct ucred cred;
+	socklen_t len = sizeof (cred);
+	
+	if (getsockopt (fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0) {
+		return 0;
+	}
+	return cred.uid == getuid ();
+#else
+	uid_t uid;
+	gid_t gid;
+	
+	if (getpeereid (fd, &uid, &gid) < 0) {
+		return 0;
+	}
+	return uid == getuid ();
+#endif
+}
+
+/* connect to path, but only if it is our socket with our daemon behind it */
+static int
+daemon_connect (const char *path)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int fd;
+	
+	if (strlen (path) >= sizeof (addr.sun_path)) {
+		return -1;
+	}
+	if (lstat (path, &st) < 0 || !S_ISSOCK (st.st_mode) || st.st_uid != getuid ()) {
+		return -1;
+	}
+	
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		return -1;
+	}
+	
+	memset (&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+	strcpy (addr.sun_path, path);
+	
+	if (connect (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0) {
+		close (fd);
+		return -1;
+	}
+	if (!daemon_peer_trusted (fd)) {
+		log_warn ("%s: daemon runs as another user, not talking to it", path);
+		close (fd);
+		return -1;
+	}
+	
+	return fd;
+}
+
+/*
+ * Send one request to the daemon of display_name and copy its reply, less
+ * the status line, to reply (which may be NULL). Returns 1 when the daemon
+ * said ok, 0 when it said error and -1 when there is no daemon to ask.
+ */
+int
+daemon_request (const char *display_name, const char *request, FILE *reply)
+{
+	char line[DAEMON_MAX_REQUEST];
+	char *path;
+	FILE *in;
+	int fd;
+	int ok = 0;
+	
+	path = daemon_socket_path (display_name);
+	if (!path) {
+		return -1;
+	}
+	fd = daemon_connect (path);
+	free (path);
+	if (fd < 0) {
+		return -1;
+	}
+	
+	if (strlen (request) >= DAEMON_MAX_REQUEST - 1) {
+		/* the daemon would refuse it anyway */
+		close (fd);
+		if (reply) {
+			fprintf (reply, "request longer than %d bytes\n", DAEMON_MAX_REQUEST - 2);
+		}
+		return 0;
+	}
+	
+	if (write (fd, request, strlen (request)) < 0 || write (fd, "\n", 1) < 0) {
+		close (fd);
+		return -1;
+	}
+	shutdown (fd, SHUT_WR);
+	
+	in = fdopen (fd, "r");
+	if (!in) {
+		/* the request is out, so it is too late to do it ourselves */
+		log_error ("daemon: cannot read the reply: %s", strerror (errno));
+		close (fd);
+		return 0;
+	}
+	while (fgets (line, sizeof (line), in)) {
+		if (strcmp (line, "ok\n") == 0) {
+			ok = 1;
+		} else if (strcmp (line, "error\n") == 0) {
+			ok = 0;
+		} else if (reply) {
+			fputs (line, reply);
+		}
+	}
+	fclose (in);
+	
+	return ok;
+}
+
+static int
+daemon_listen (const char *path)
+{
+	struct sockaddr_un addr;
+	mode_t old_mask;
+	int fd;
+	
+	fd = daemon_connect (path);
+	if (fd >= 0) {
+		close (fd);
+		fprintf (stderr, "a daemon is already listening on %s\n", path);
+		return -1;
+	}
+	
+	if (strlen (path) >= sizeof (addr.sun_path)) {
+		fprintf (stderr, "%s: socket path too long\n", path);
+		return -1;
+	}
+	
+	/* nobody answered, so whatever is there is left over from a crash */
+	unlink (path);
+	
+	fd = socket (AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		perror ("socket");
+		return -1;
+	}
+	
+	memset (&addr, 0, sizeof (addr));
+	addr.sun_family = AF_UNIX;
+	strcpy (addr.sun_path, path);
+	
+	old_mask = umask (077);
+	if (bind (fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 || listen (fd, 8) < 0) {
+		perror (path);
+		umask (old_mask);
+		close (fd);
+		return -1;
+	}
+	umask (old_mask);
+	
+	return fd;
+}
+
+static void
+daemon_reload (struct Daemon *daemon, int probe)
+{
+	struct ScreenInfo *screen_info;
+	
+	screen_info = read_screen_info (daemon->dpy, probe);
+	if (!screen_info) {
+		/* keep serving from the old one, the next event tries again */
+		return;
+	}
+	select_screen_events (screen_info);
+	free_screen_info (daemon->screen_info);
+	daemon->screen_info = screen_info;
+}
+
+/* fold everything the server told us into the snapshot */
+static void
+daemon_handle_events (struct Daemon *daemon)
+{
+	struct OutputInfo *output;
+	XEvent event;
+	int stale = 0;
+	
+	trace_begin ("handle_events", 0);
+	while (XPending (daemon->dpy)) {
+		XNextEvent (daemon->dpy, &event);
+		if (screen_info_handle_event (daemon->screen_info, &event, &output) & SCREEN_EVENT_STALE) {
+			stale = 1;
+		}
+	}
+	
+	if (stale) {
+		daemon_reload (daemon, 0);
+	}
+	trace_end ("handle_events", 0);
+}
+
+static int
+daemon_apply (struct Daemon *daemon, int argc, char **argv, FILE *out)
+{
+	struct OutputRequest *reqs;
+	int n_req;
+	int ok = 0;
+	
+	reqs = malloc (sizeof (struct OutputRequest) * (argc + 1));
+	n_req = parse_output_requests (argc, argv, reqs, out);
+	if (n_req > 0) {
+		revert_screen_info (daemon->screen_info);
+		ok = apply_output_requests (daemon->screen_info, reqs, n_req, out);
+		if (ok < 0) {
+			/* probing found new modes, start over from the server's view */
+			daemon_reload (daemon, 0);
+			ok = apply_output_requests (daemon->screen_info, reqs, n_req, out) > 0;
+		}
+		if (!ok) {
+			revert_screen_info (daemon->screen_info);
+		}
+	} else if (n_req == 0) {
+		fprintf (out, "nothing to apply\n");
+	}
+	free (reqs);
+	
+	return ok;
+}
+
+static int
+split_args (char *line, char **argv, int max_arg)
+{
+	char *tok;
+	int argc = 0;
+	
+	for (tok = strtok (line, " \t\r\n"); tok && argc < max_arg; tok = strtok (NULL, " \t\r\n")) {
+		argv[argc++] = tok;
+	}
+	
+	return argc;
+}
+
+/* a profile is a file of grandr-cli --output blocks, # starts a comment */
+static int
+daemon_profile (struct Daemon *daemon, const char *name, FILE *out)
+{
+	char buf[DAEMON_MAX_REQUEST];
+	char *argv[DAEMON_MAX_REQUEST / 2];
+	char path[1024];
+	const char *config;
+	size_t len = 0;
+	FILE *file;
+	int argc;
+	
+	if (strchr (name, '/') || name[0] == '.') {
+		fprintf (out, "%s: bad profile name\n", name);
+		return 0;
+	}
+	
+	config = getenv ("XDG_CONFIG_HOME");
+	if (config && *config) {
+		snprintf (path, sizeof (path), "%s/grandr/profiles/%s", config, name);
+	} else {
+		snprintf (path, sizeof (path), "%s/.config/grandr/profiles/%s", 
+					 getenv ("HOME") ? getenv ("HOME") : "", name);
+	}
+	
+	file = fopen (path, "r");
+	if (!file) {
+		fprintf (out, "%s: %s\n", path, strerror (errno));
+		return 0;
+	}
+	while (len < sizeof (buf) - 1 && fgets (buf + len, sizeof (buf) - len, file)) {
+		if (buf[len] == '#') {
+			continue;
+		}
+		len += strlen (buf + len);
+	}
+	buf[len] = '\0';
+	fclose (file);
+	
+	argc = split_args (buf, argv, DAEMON_MAX_REQUEST / 2);
+	
+	return daemon_apply (daemon, argc, argv, out);
+}
+
+/*
+ * The built-in layouts, in the spirit of a laptop display switch key: all
+ * connected outputs side by side, then each connected output on its own.
+ * Returns -1, with nothing changed, if switching an output on needs a
+ * fresh snapshot first (see output_auto ()).
+ */
+static int
+daemon_cycle_once (struct Daemon *daemon, FILE *out)
+{
+	struct ScreenInfo *screen_info = daemon->screen_info;
+	struct OutputInfo **connected;
+	int n_connected = 0;
+	int n_layout, layout;
+	int x = 0;
+	int i, ok;
+	
+	connected = malloc (sizeof (struct OutputInfo *) * (screen_info->n_output + 1));
+	if (!connected) {
+		fprintf (out, "out of memory\n");
+		return 0;
+	}
+	
+	revert_screen_info (screen_info);
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct OutputInfo *output = &screen_info->outputs[i];
+		
+		if (output->info->connection == RR_Connected) {
+			connected[n_connected++] = output;
+		} else if (output->cur_crtc) {
+			output_off (screen_info, output);
+		}
+	}
+	
+	if (!n_connected) {
+		fprintf (out, "no connected outputs\n");
+		free (connected);
+		return 0;
+	}
+	
+	n_layout = n_connected == 1 ? 1 : n_connected + 1;
+	layout = daemon->cycle % n_layout;
+	
+	for (i = 0; i < n_connected; i++) {
+		struct OutputInfo *output = connected[i];
+		struct CrtcInfo *crtc_info;
+		XRRModeInfo *mode_info;
+		
+		if (layout && i != layout - 1) {
+			output_off (screen_info, output);
+			continue;
+		}
+		
+		if (output_auto (screen_info, output) < 0) {
+			revert_screen_info (screen_info);
+			free (connected);
+			return -1;
+		}
+		crtc_info = output->cur_crtc;
+		if (!crtc_info) {
+			continue;
+		}
+		crtc_info->cur_x = x;
+		crtc_info->cur_y = 0;
+		mode_info = find_mode_by_xid (screen_info, crtc_info->cur_mode_id);
+		if (mode_info) {
+			x += mode_width (mode_info, crtc_info->cur_rotation);
+		}
+	}
+	free (connected);
+	daemon->cycle = layout + 1;
+	
+	if (validate_screen_info (screen_info, out) || !assign_crtcs (screen_info, out)) {
+		ok = 0;
+	} else if (!set_screen_size (screen_info)) {
+		fprintf (out, "screen size larger than max screen size\n");
+		ok = 0;
+	} else {
+		ok = apply_screen_info (screen_info);
+	}
+	if (!ok) {
+		revert_screen_info (screen_info);
+	}
+	
+	fprintf (out, "layout %d of %d\n", layout + 1, n_layout);
+	
+	return ok;
+}
+
+static int
+daemon_cycle (struct Daemon *daemon, FILE *out)
+{
+	int ok;
+	
+	ok = daemon_cycle_once (daemon, out);
+	if (ok < 0) {
+		/* probing found new modes, start over from the server's view */
+		daemon_reload (daemon, 0);
+		ok = daemon_cycle_once (daemon, out);
+	}
+	if (ok < 0) {
+		fprintf (out, "the outputs changed while probing, try again\n");
+		ok = 0;
+	}
+	
+	return ok;
+}
+
+static int
+daemon_dispatch (struct Daemon *daemon, int argc, char **argv, FILE *out)
+{
+	if (argc == 0) {
+		fprintf (out, "empty request\n");
+		return 0;
+	}
+	
+	if (strcmp (argv[0], "apply") == 0) {
+		return daemon_apply (daemon, argc - 1, argv + 1, out);
+	} else if (strcmp (argv[0], "profile") == 0 && argc == 2) {
+		return daemon_profile (daemon, argv[1], out);
+	} else if (strcmp (argv[0], "cycle") == 0) {
+		return daemon_cycle (daemon, out);
+	} else if (strcmp (argv[0], "dump") == 0) {
+		print_screen_info (daemon->screen_info, out);
+		return 1;
+	} else if (strcmp (argv[0], "reload") == 0) {
+		daemon_reload (daemon, 1);
+		return 1;
+	}
+	
+	fprintf (out, "%s: unknown request\n", argv[0]);
+	return 0;
+}
+
+/* read one request line from a new client and answer it */
+static void
+daemon_serve (struct Daemon *daemon)
+{
+	char line[DAEMON_MAX_REQUEST];
+	char *argv[DAEMON_MAX_REQUEST / 2];
+	struct timeval timeout = { 1, 0 };
+	size_t len = 0;
+	ssize_t n;
+	FILE *out;
+	int fd;
+	int argc, ok;
+	
+	fd = accept (daemon->listen_fd, NULL, NULL);
+	if (fd < 0) {
+		return;
+	}
+	if (!daemon_peer_trusted (fd)) {
+		log_warn ("daemon: dropping a client of another user");
+		close (fd);
+		return;
+	}
+	/* a stuck client must not hold up the display */
+	setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+	
+	while (len < sizeof (line) - 1 && 
+			 (n = read (fd, line + len, sizeof (line) - 1 - len)) > 0) {
+		len += n;
+		if (memchr (line + len - n, '\n', n)) {
+			break;
+		}
+	}
+	line[len] = '\0';
+	
+	out = fdopen (fd, "w");
+	if (!out) {
+		log_error ("daemon: cannot answer a client: %s", strerror (errno));
+		close (fd);
+		return;
+	}
+	
+	if (len == sizeof (line) - 1 && !memchr (line, '\n', len)) {
+		/* whatever we did with the first part of it would be a guess */
+		fprintf (out, "request longer than %d bytes\n", DAEMON_MAX_REQUEST - 2);
+		fputs ("error\n", out);
+		fclose (out);
+		log_warn ("daemon: dropping an over-long request");
+		return;
+	}
+	
+	/* events may have arrived while we were asleep in poll () */
+	daemon_handle_events (daemon);
+	
+	argc = split_args (line, argv, DAEMON_MAX_REQUEST / 2);
+	trace_begin ("daemon_request", 0);
+	ok = daemon_dispatch (daemon, argc, argv, out);
+	trace_end ("daemon_request", 0);
+	fputs (ok ? "ok\n" : "error\n", out);
+	fclose (out);
+	
+	log_info ("daemon: %s -> %s", argc ? argv[0] : "", ok ? "ok" : "error");
+}
+
+static void
+daemon_signal (int sig)
+{
+	daemon_quit = 1;
+}
+
+/* serve requests for dpy until killed, returns 0 if it could not start */
+int
+run_daemon (Display *dpy)
+{
+	struct Daemon daemon;
+	struct pollfd fds[2];
+	char *path;
+	
+	path = daemon_socket_path (DisplayString (dpy));
+	if (!path) {
+		fprintf (stderr, "XDG_RUNTIME_DIR is not set, not starting a daemon\n");
+		return 0;
+	}
+	daemon.listen_fd = daemon_listen (path);
+	if (daemon.listen_fd < 0) {
+		free (path);
+		return 0;
+	}
+	
+	daemon.dpy = dpy;
+	daemon.cycle = 0;
+	daemon.screen_info = read_screen_info (dpy, 0);
+	if (!daemon.screen_info) {
+		close (daemon.listen_fd);
+		unlink (path);
+		free (path);
+		return 0;
+	}
+	select_screen_events (daemon.screen_info);
+	
+	signal (SIGPIPE, SIG_IGN);
+	signal (SIGINT, daemon_signal);
+	signal (SIGTERM, daemon_signal);
+	
+	while (!daemon_quit) {
+		daemon_handle_events (&daemon);
+		
+		fds[0].fd = ConnectionNumber (dpy);
+		fds[0].events = POLLIN;
+		fds[1].fd = daemon.listen_fd;
+		fds[1].events = POLLIN;
+		if (poll (fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			perror ("poll");
+			break;
+		}
+		
+		if (fds[1].revents & POLLIN) {
+			daemon_serve (&daemon);
+		}
+	}
+	
+	close (daemon.listen_fd);
+	unlink (path);
+	free (path);
+	free_screen_info (daemon.screen_info);
+	
+	return 1;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_DAEMON_H
+#define RANDR_GUI_DAEMON_H
+
+/*
+ * The resident daemon keeps one warm, event-updated ScreenInfo and takes
+ * requests on a UNIX socket, one line per connection:
+ *
+ *   apply <--output blocks>	set a layout, in grandr-cli syntax
+ *   profile <name>		apply $XDG_CONFIG_HOME/grandr/profiles/<name>
+ *   cycle			step through the built-in layouts
+ *   dump			print the current state
+ *   reload			reprobe every output
+ *
+ * The reply is free text ending with a line saying "ok" or "error".
+ */
+
+#include <stdio.h>
+#include <X11/Xlib.h>
+
+char *daemon_socket_path (const char *display_name);
+int daemon_request (const char *display_name, const char *request, FILE *reply);
+int run_daemon (Display *dpy);
+
+#endif
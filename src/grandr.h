@@ -22,104 +22,62 @@
 #ifndef RANDR_GUI_H
 #define RANDR_GUI_H
 
-#include <X11/Xlib.h>
-#include <X11/extensions/Xrandr.h>
 #include <gtk/gtk.h>
 
-#include "constant.h"
+#include "screen.h"
 
-struct ScreenInfo;
-
-struct CrtcInfo {
-	RRCrtc id;
-	XRRCrtcInfo *info;
-	int cur_x;
-	int cur_y;
-	RRMode cur_mode_id;
-	Rotation cur_rotation;
-	Rotation rotations;
-	int cur_noutput;
-	
-	int changed;
-	
-	struct ScreenInfo *screen_info;
-};
-
-struct OutputInfo {
-	RROutput id;
-	XRROutputInfo *info;
-	struct CrtcInfo *cur_crtc;
-	
-	int auto_set;
-	int off_set;
-};
-
-struct ScreenInfo {
-	Display *dpy;
-	Window window;
-	XRRScreenResources *res;
-	int min_width, min_height;
-	int max_width, max_height;
-	int cur_width;
-	int cur_height;
-	int cur_mmWidth;
-	int cur_mmHeight;
-	
-  	int n_output;
-  	int n_crtc;
-  	struct OutputInfo **outputs;
-  	struct CrtcInfo **crtcs;
-  	
-  	int clone;
-  	struct CrtcInfo *primary_crtc;
-  	
-  	struct CrtcInfo *cur_crtc;
-  	struct OutputInfo *cur_output;
+/* the named widgets of the main window, see lookup_main_widgets () */
+struct MainWidgets {
+	GtkIconView *output_iview;
+	GtkIconView *pos_iview[N_POSITIONS];	/* indexed by LEFT_POS ... CENTER_POS */
+	GtkComboBox *modes_combo;
+	GtkToggleButton *auto_cbtn;
+	GtkToggleButton *off_cbtn;
+	GtkNotebook *setting_notebook;
+	GtkRadioButton *rotation_rbtn;
+	GtkImage *rotation_img;
+	GtkToggleButton *hotkey_cbtn;
+	GtkTreeView *hotkey_tview;
+	GtkWidget *ok_btn;
+	GtkWidget *apply_btn;
 };
 
 extern GtkWidget *root_window;
+extern struct MainWidgets main_widgets;
 extern struct ScreenInfo *screen_info;
 extern GtkListStore *output_store;
 extern GtkListStore *center_store, *left_store, *right_store, *above_store, *below_store;
 extern GtkListStore *mode_store;
 extern const guint8 big_pixbuf[], small_pixbuf[];
-void free_screen_info (struct ScreenInfo *screen_info);
-GdkPixbuf* randr_create_pixbuf (const guint8 *data);
+GdkPixbuf* randr_ref_pixbuf (const guint8 *data);
+void randr_free_pixbufs (void);
 
-struct ScreenInfo* read_screen_info (Display *);
+void lookup_main_widgets (struct MainWidgets *widgets, GtkWidget *main_win);
 
 GtkListStore* create_output_store ();
 GtkListStore* create_mode_store ();
 GtkListStore* create_hotkey_store ();
-void set_output_store (GtkListStore *store, const char *widget_name);
-void set_mode_store (GtkListStore *store, const char *widget_name);
-void set_hotkey_store (GtkListStore *store, const char *widget_name);
+void set_output_store (GtkListStore *store, GtkIconView *output_iview);
+void set_mode_store (GtkListStore *store, GtkComboBox *modes_combo);
+void set_hotkey_store (GtkListStore *store, GtkTreeView *hotkey_tview);
 void fill_output_store (GtkListStore *store, struct ScreenInfo *screen_info, int big_pic, int output_type);
 void fill_crtc_store (GtkListStore *store, struct ScreenInfo *screen_info, int big_pic);
-void fill_mode_store (GtkListStore *store, struct OutputInfo *output);
+void fill_mode_store (struct MainWidgets *widgets, GtkListStore *store, struct OutputInfo *output);
 void fill_hotkey_store (GtkListStore *store);
-void set_basic_views (struct OutputInfo *output_info);
-void set_rotation_views (struct CrtcInfo* crtc_info);
-void set_output_layout (struct ScreenInfo *screen_info);
-void set_hotkeys_view (GtkListStore *hotkey_store);
-void set_hotkeys ();
-void set_positions (struct ScreenInfo *);
+void set_basic_views (struct MainWidgets *widgets, struct OutputInfo *output_info);
+void set_rotation_views (struct MainWidgets *widgets, struct CrtcInfo* crtc_info);
+void set_output_layout (struct MainWidgets *widgets, struct ScreenInfo *screen_info);
+void set_hotkeys_view (struct MainWidgets *widgets, GtkListStore *hotkey_store);
+void set_hotkeys (struct MainWidgets *widgets);
+int set_positions (struct MainWidgets *widgets, struct ScreenInfo *, FILE *err);
 
 int apply (struct ScreenInfo *screen_info);
-int set_screen_size (struct ScreenInfo *screen_info);
-void output_auto (struct ScreenInfo *screen_info, struct OutputInfo *output_info);
-void output_off (struct ScreenInfo *screen_info, struct OutputInfo *output);
-struct CrtcInfo* auto_find_crtc (struct ScreenInfo *screen_info, struct OutputInfo *output_info);
+int set_clone_layout (struct MainWidgets *widgets, struct ScreenInfo *screen_info);
+void check_pending_config (struct MainWidgets *widgets, struct ScreenInfo *screen_info);
+void set_randr_event_filter (struct ScreenInfo *screen_info);
+void unset_randr_event_filter (void);
+void reload_screen_info (void);
+gboolean confirm_cached_screen_info (gpointer data);
 
-XRRModeInfo *find_mode_by_xid (struct ScreenInfo *screen_info, RRMode mode_id);
-int mode_height (XRRModeInfo *mode_info, Rotation rotation);
-int mode_width (XRRModeInfo *mode_info, Rotation rotation);
-int get_width_by_output_id (struct ScreenInfo *screen_info, RROutput output_id);
-int get_height_by_output_id (struct ScreenInfo *screen_info, RROutput output_id);
-char *get_output_name (struct ScreenInfo *screen_info, RROutput id);
 int get_iconview_child_count (GtkIconView *iconview);
-int get_iconview_child_max_width (GtkIconView *iconview);
-int get_iconview_child_max_height (GtkIconView *iconview);
-int get_x (int position);
-int get_y (int position);
 #endif
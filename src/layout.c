@@ -0,0 +1,427 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "layout.h"
+
+struct LayoutEdge {
+	int to;
+	int dx, dy;		/* position of to, relative to the node the edge leaves */
+};
+
+void
+layout_init (struct Layout *layout, struct ScreenInfo *screen_info)
+{
+	layout->screen_info = screen_info;
+	layout->n_relation = 0;
+	layout->size = 0;
+	layout->relations = NULL;
+	layout->out_of_memory = 0;
+}
+
+void
+layout_add (struct Layout *layout, int type, 
+				struct CrtcInfo *crtc, struct CrtcInfo *anchor, int x, int y)
+{
+	struct LayoutRelation *relation;
+	
+	if (layout->n_relation == layout->size) {
+		int size = layout->size ? layout->size * 2 : 8;
+		
+		relation = realloc (layout->relations, sizeof (struct LayoutRelation) * size);
+		if (!relation) {
+			layout->out_of_memory = 1;
+			return;
+		}
+		layout->relations = relation;
+		layout->size = size;
+	}
+	
+	relation = &layout->relations[layout->n_relation++];
+	relation->type = type;
+	relation->crtc = crtc;
+	relation->anchor = anchor;
+	relation->x = x;
+	relation->y = y;
+}
+
+void
+layout_free (struct Layout *layout)
+{
+	free (layout->relations);
+	layout->relations = NULL;
+	layout->n_relation = layout->size = 0;
+}
+
+static int
+crtc_is_lit (struct CrtcInfo *crtc_info)
+{
+	return crtc_info->cur_noutput > 0 && crtc_info->cur_mode_id != None;
+}
+
+/* name a crtc after the first output it drives, for error messages */
+static const char *
+crtc_name (struct ScreenInfo *screen_info, struct CrtcInfo *crtc_info)
+{
+	int i;
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		if (screen_info->outputs[i].cur_crtc == crtc_info) {
+			return screen_info->outputs[i].info->name;
+		}
+	}
+	
+	return "crtc";
+}
+
+static void
+crtc_size (struct ScreenInfo *screen_info, struct CrtcInfo *crtc_info, int *w, int *h)
+{
+	XRRModeInfo *mode_info;
+	
+	mode_info = find_mode_by_xid (screen_info, crtc_info->cur_mode_id);
+	if (!mode_info) {
+		*w = *h = 0;
+		return;
+	}
+	*w = mode_width (mode_info, crtc_info->cur_rotation);
+	*h = mode_height (mode_info, crtc_info->cur_rotation);
+}
+
+/* offset of relation->crtc from relation->anchor */
+static void
+relation_offset (struct ScreenInfo *screen_info, struct LayoutRelation *relation, 
+					  int *dx, int *dy)
+{
+	int w, h;
+	
+	*dx = *dy = 0;
+	switch (relation->type) {
+		case LAYOUT_LEFT_OF:
+			crtc_size (screen_info, relation->crtc, &w, &h);
+			*dx = -w;
+			break;
+		case LAYOUT_RIGHT_OF:
+			crtc_size (screen_info, relation->anchor, &w, &h);
+			*dx = w;
+			break;
+		case LAYOUT_ABOVE:
+			crtc_size (screen_info, relation->crtc, &w, &h);
+			*dy = -h;
+			break;
+		case LAYOUT_BELOW:
+			crtc_size (screen_info, relation->anchor, &w, &h);
+			*dy = h;
+			break;
+		case LAYOUT_ABSOLUTE:
+			*dx = relation->x;
+			*dy = relation->y;
+			break;
+		default:
+			break;
+	}
+}
+
+/*
+ * Breadth first walk from start, placing every node reached. Returns the
+ * number of nodes placed (appended to queue), or -1 on a conflict, when a
+ * node is reached again at a different position.
+ */
+static int
+place_component (struct Layout *layout, int start, int *first, struct LayoutEdge *edges,
+					  int *placed, int *pos_x, int *pos_y, int *queue, FILE *err)
+{
+	struct ScreenInfo *screen_info = layout->screen_info;
+	int head = 0, tail = 0;
+	int e;
+	
+	placed[start] = 1;
+	queue[tail++] = start;
+	
+	while (head < tail) {
+		int node = queue[head++];
+		
+		for (e = first[node]; e < first[node + 1]; e++) {
+			int to = edges[e].to;
+			int x = pos_x[node] + edges[e].dx;
+			int y = pos_y[node] + edges[e].dy;
+			
+			if (!placed[to]) {
+				placed[to] = 1;
+				pos_x[to] = x;
+				pos_y[to] = y;
+				queue[tail++] = to;
+			} else if (pos_x[to] != x || pos_y[to] != y) {
+				if (err) {
+					fprintf (err, "%s: conflicting placement, %d,%d and %d,%d\n",
+								to < screen_info->n_crtc ? 
+								crtc_name (screen_info, &screen_info->crtcs[to]) : "screen",
+								pos_x[to], pos_y[to], x, y);
+				}
+				return -1;
+			}
+		}
+	}
+	
+	return tail;
+}
+
+/*
+ * Turn the relations into coordinates. The crtcs are the nodes of a graph
+ * with an extra root node for the screen origin, every relation an edge
+ * in both directions carrying the offset between its ends. Components tied
+ * to the root keep their absolute offsets; free components are placed one
+ * after the other to the right. Finally everything is moved so no crtc is
+ * at a negative position. On success the cur_x/cur_y of every lit crtc are
+ * set and 1 is returned; on a conflict (or out of memory) nothing is
+ * touched.
+ */
+int
+layout_solve (struct Layout *layout, FILE *err)
+{
+	struct ScreenInfo *screen_info = layout->screen_info;
+	struct LayoutEdge *edges;
+	int n_node = screen_info->n_crtc + 1;
+	int root = screen_info->n_crtc;
+	int *first, *fill, *mentioned;
+	int *placed, *pos_x, *pos_y, *queue;
+	int min_x = 0, min_y = 0, right = 0;
+	int ok = 1;
+	int i, j, n;
+	
+	first = calloc (n_node + 1, sizeof (int));
+	fill = calloc (n_node, sizeof (int));
+	mentioned = calloc (n_node, sizeof (int));
+	placed = calloc (n_node, sizeof (int));
+	pos_x = calloc (n_node, sizeof (int));
+	pos_y = calloc (n_node, sizeof (int));
+	queue = malloc (sizeof (int) * n_node);
+	edges = malloc (sizeof (struct LayoutEdge) * 2 * (layout->n_relation + n_node));
+	if (layout->out_of_memory || !first || !fill || !mentioned || !placed || 
+		 !pos_x || !pos_y || !queue || !edges) {
+		if (err) {
+			fprintf (err, "out of memory\n");
+		}
+		ok = 0;
+		goto out;
+	}
+	
+	/* resolve relation ends to node indices, dropping what cannot be placed */
+	for (i = 0; i < layout->n_relation; i++) {
+		struct LayoutRelation *relation = &layout->relations[i];
+		int a, b;
+		
+		a = xid_hash_lookup (&screen_info->crtc_hash, relation->crtc->id);
+		b = relation->anchor ? xid_hash_lookup (&screen_info->crtc_hash, relation->anchor->id) : root;
+		if (a < 0 || b < 0 || !crtc_is_lit (relation->crtc) ||
+			 (relation->anchor && !crtc_is_lit (relation->anchor))) {
+			if (err) {
+				fprintf (err, "%s: output is off\n", 
+							crtc_name (screen_info, relation->anchor && crtc_is_lit (relation->crtc) ?
+										  relation->anchor : relation->crtc));
+			}
+			ok = 0;
+			goto out;
+		}
+		mentioned[a] = mentioned[b] = 1;
+		first[a + 1]++;
+		first[b + 1]++;
+	}
+	
+	/* lit crtcs nobody talks about stay where they are */
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		if (!mentioned[i] && crtc_is_lit (&screen_info->crtcs[i])) {
+			first[i + 1]++;
+			first[root + 1]++;
+		}
+	}
+	
+	for (i = 0; i < n_node; i++) {
+		first[i + 1] += first[i];
+	}
+	
+#define ADD_EDGE(from, to_, dx_, dy_) do { \
+		struct LayoutEdge *edge = &edges[first[from] + fill[from]++]; \
+		edge->to = (to_); \
+		edge->dx = (dx_); \
+		edge->dy = (dy_); \
+	} while (0)
+	
+	for (i = 0; i < layout->n_relation; i++) {
+		struct LayoutRelation *relation = &layout->relations[i];
+		int a = xid_hash_lookup (&screen_info->crtc_hash, relation->crtc->id);
+		int b = relation->anchor ? xid_hash_lookup (&screen_info->crtc_hash, relation->anchor->id) : root;
+		int dx, dy;
+		
+		relation_offset (screen_info, relation, &dx, &dy);
+		ADD_EDGE (b, a, dx, dy);
+		ADD_EDGE (a, b, -dx, -dy);
+	}
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		struct CrtcInfo *crtc_info = &screen_info->crtcs[i];
+		
+		if (!mentioned[i] && crtc_is_lit (crtc_info)) {
+			ADD_EDGE (root, i, crtc_info->cur_x, crtc_info->cur_y);
+			ADD_EDGE (i, root, -crtc_info->cur_x, -crtc_info->cur_y);
+		}
+	}
+#undef ADD_EDGE
+	
+	n = place_component (layout, root, first, edges, placed, pos_x, pos_y, queue, err);
+	if (n < 0) {
+		ok = 0;
+		goto out;
+	}
+	for (j = 1; j < n; j++) {
+		int w, h;
+		
+		crtc_size (screen_info, &screen_info->crtcs[queue[j]], &w, &h);
+		if (pos_x[queue[j]] + w > right) {
+			right = pos_x[queue[j]] + w;
+		}
+	}
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		int comp_x, comp_y, comp_right;
+		
+		if (placed[i] || !mentioned[i]) {
+			continue;
+		}
+		
+		n = place_component (layout, i, first, edges, placed, pos_x, pos_y, queue, err);
+		if (n < 0) {
+			ok = 0;
+			goto out;
+		}
+		
+		comp_x = pos_x[queue[0]];
+		comp_y = pos_y[queue[0]];
+		for (j = 1; j < n; j++) {
+			if (pos_x[queue[j]] < comp_x) {
+				comp_x = pos_x[queue[j]];
+			}
+			if (pos_y[queue[j]] < comp_y) {
+				comp_y = pos_y[queue[j]];
+			}
+		}
+		comp_right = right;
+		for (j = 0; j < n; j++) {
+			int w, h;
+			
+			pos_x[queue[j]] += right - comp_x;
+			pos_y[queue[j]] -= comp_y;
+			crtc_size (screen_info, &screen_info->crtcs[queue[j]], &w, &h);
+			if (pos_x[queue[j]] + w > comp_right) {
+				comp_right = pos_x[queue[j]] + w;
+			}
+		}
+		right = comp_right;
+	}
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		if (!placed[i]) {
+			continue;
+		}
+		if (pos_x[i] < min_x) {
+			min_x = pos_x[i];
+		}
+		if (pos_y[i] < min_y) {
+			min_y = pos_y[i];
+		}
+	}
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		if (!placed[i]) {
+			continue;
+		}
+		screen_info->crtcs[i].cur_x = pos_x[i] - min_x;
+		screen_info->crtcs[i].cur_y = pos_y[i] - min_y;
+	}
+	
+out:
+	free (first);
+	free (fill);
+	free (mentioned);
+	free (placed);
+	free (pos_x);
+	free (pos_y);
+	free (queue);
+	free (edges);
+	
+	return ok;
+}
+
+/*
+ * Lay regions out around an anchor: the first crtc of the first
+ * LAYOUT_SAME_AS region holding any, else the first crtc of any region.
+ * The anchor is pinned at 0,0, then the whole layout is shifted so that
+ * its top left corner is at 0,0; the anchor only stays at the origin if
+ * nothing ends up left of or above it. Returns 0 if the relations conflict.
+ */
+int
+layout_solve_regions (struct ScreenInfo *screen_info, struct LayoutRegion *regions, 
+							 int n_region, FILE *err)
+{
+	struct Layout layout;
+	struct CrtcInfo *anchor = NULL;
+	struct CrtcInfo *prev;
+	int ok;
+	int i, j;
+	
+	for (i = 0; i < n_region && !anchor; i++) {
+		if (LAYOUT_SAME_AS == regions[i].relation && regions[i].n_crtc) {
+			anchor = regions[i].crtcs[0];
+		}
+	}
+	for (i = 0; i < n_region && !anchor; i++) {
+		if (regions[i].n_crtc) {
+			anchor = regions[i].crtcs[0];
+		}
+	}
+	if (!anchor) {
+		return 1;
+	}
+	
+	layout_init (&layout, screen_info);
+	layout_add (&layout, LAYOUT_ABSOLUTE, anchor, NULL, 0, 0);
+	
+	for (i = 0; i < n_region; i++) {
+		prev = anchor;
+		for (j = 0; j < regions[i].n_crtc; j++) {
+			struct CrtcInfo *crtc_info = regions[i].crtcs[j];
+			
+			if (crtc_info == anchor) {
+				continue;
+			}
+			layout_add (&layout, regions[i].relation, crtc_info, prev, 0, 0);
+			if (LAYOUT_SAME_AS != regions[i].relation) {
+				prev = crtc_info;
+			}
+		}
+	}
+	
+	ok = layout_solve (&layout, err);
+	layout_free (&layout);
+	
+	return ok;
+}
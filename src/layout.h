@@ -0,0 +1,77 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_LAYOUT_H
+#define RANDR_GUI_LAYOUT_H
+
+#include <stdio.h>
+#include "screen.h"
+
+enum {
+	LAYOUT_LEFT_OF,
+	LAYOUT_RIGHT_OF,
+	LAYOUT_ABOVE,
+	LAYOUT_BELOW,
+	LAYOUT_SAME_AS,
+	LAYOUT_ABSOLUTE
+};
+
+/* crtc is placed relative to anchor, or at x, y for LAYOUT_ABSOLUTE */
+struct LayoutRelation {
+	int type;
+	struct CrtcInfo *crtc;
+	struct CrtcInfo *anchor;	/* NULL for LAYOUT_ABSOLUTE */
+	int x, y;
+};
+
+/*
+ * A set of placement relations between the crtcs of a snapshot. Solving it
+ * walks the relation graph once, so it is linear in crtcs plus relations.
+ * Crtcs that are on but not mentioned keep their current position.
+ */
+struct Layout {
+	struct ScreenInfo *screen_info;
+	int n_relation;
+	int size;
+	struct LayoutRelation *relations;
+	int out_of_memory;		/* a relation was dropped, layout_solve () fails */
+};
+
+/*
+ * Crtcs grouped the way the GUI position views hold them: every crtc of a
+ * region stands in relation to the previous one, the first to the anchor.
+ * LAYOUT_SAME_AS regions all sit on the anchor instead of chaining.
+ */
+struct LayoutRegion {
+	int relation;
+	struct CrtcInfo **crtcs;
+	int n_crtc;
+};
+
+void layout_init (struct Layout *layout, struct ScreenInfo *screen_info);
+void layout_add (struct Layout *layout, int type, 
+					  struct CrtcInfo *crtc, struct CrtcInfo *anchor, int x, int y);
+int layout_solve (struct Layout *layout, FILE *err);
+void layout_free (struct Layout *layout);
+int layout_solve_regions (struct ScreenInfo *screen_info, struct LayoutRegion *regions, 
+								  int n_region, FILE *err);
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * Writers claim a slot by bumping the ring head atomically, fill it in
+ * and then publish it by storing its sequence number. A flush only
+ * write ()s slots whose sequence is published, so it is safe in signal
+ * handlers and never prints a line that is still being written. When
+ * the ring wraps the oldest lines are overwritten, which is the point.
+ */
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "log.h"
+
+#define LOG_RING_SIZE	1024	/* lines kept, a power of two */
+#define LOG_LINE			256	/* longer lines are cut */
+
+struct LogSlot {
+	volatile unsigned long seq;	/* 1 + the line number once published */
+	int len;
+	char text[LOG_LINE];
+};
+
+int log_level = LOG_LEVEL_NONE;
+
+static struct {
+	struct LogSlot slots[LOG_RING_SIZE];
+	volatile unsigned long head;		/* next line number */
+	unsigned long flushed;				/* lines up to here are out */
+	volatile int flushing;
+	double start;
+	int fd;
+} log_ring;
+
+static const char level_char[] = { '-', 'E', 'W', 'I', 'D' };
+
+static const char *level_names[] = { "none", "error", "warn", "info", "debug" };
+
+static const int crash_signals[] = { SIGSEGV, SIGBUS, SIGILL, SIGFPE, SIGABRT };
+
+static double
+log_now (void)
+{
+	struct timespec ts;
+	
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+log_flush_signal (int sig)
+{
+	log_flush ();
+}
+
+/* get the history out, then die the way we were going to */
+static void
+log_crash_signal (int sig)
+{
+	log_flush ();
+	signal (sig, SIG_DFL);
+	raise (sig);
+}
+
+static void
+log_exit (void)
+{
+	log_flush ();
+}
+
+/*
+ * Read $GRANDR_LOG and $GRANDR_LOG_FILE and hook the flushes up.
+ * Returns 1 if anything will be logged.
+ */
+int
+log_init (void)
+{
+	const char *level = getenv ("GRANDR_LOG");
+	const char *path = getenv ("GRANDR_LOG_FILE");
+	struct sigaction action;
+	int i;
+	
+	if (!level || !*level) {
+		return 0;
+	}
+	for (i = LOG_LEVEL_NONE; i <= LOG_LEVEL_DEBUG; i++) {
+		if (strcmp (level, level_names[i]) == 0) {
+			log_level = i;
+		}
+	}
+	if (LOG_LEVEL_NONE == log_level) {
+		fprintf (stderr, "GRANDR_LOG=%s: not one of error, warn, info, debug\n", level);
+		return 0;
+	}
+	
+	log_ring.start = log_now ();
+	log_ring.fd = STDERR_FILENO;
+	if (path && *path) {
+		/* the lines name outputs, profiles and socket paths: keep them ours */
+		log_ring.fd = open (path, O_WRONLY | O_CREAT | O_APPEND, 0600);
+		if (log_ring.fd < 0) {
+			fprintf (stderr, "%s: cannot open log file\n", path);
+			log_ring.fd = STDERR_FILENO;
+		}
+	}
+	
+	memset (&action, 0, sizeof (action));
+	sigemptyset (&action.sa_mask);
+	action.sa_flags = SA_RESTART;
+	action.sa_handler = log_flush_signal;
+	sigaction (SIGUSR1, &action, NULL);
+	
+	action.sa_flags = SA_RESETHAND;
+	action.sa_handler = log_crash_signal;
+	for (i = 0; i < (int) (sizeof (crash_signals) / sizeof (crash_signals[0])); i++) {
+		sigaction (crash_signals[i], &action, NULL);
+	}
+	
+	atexit (log_exit);
+	
+	return 1;
+}
+
+/* use log_error () and friends, they skip the call below the level */
+void
+log_write (int level, const char *format, ...)
+{
+	struct LogSlot *slot;
+	unsigned long seq;
+	va_list args;
+	int len;
+	
+	seq = __sync_fetch_and_add (&log_ring.head, 1);
+	slot = &log_ring.slots[seq & (LOG_RING_SIZE - 1)];
+	slot->seq = 0;
+	__sync_synchronize ();
+	
+	len = snprintf (slot->text, LOG_LINE, "[%12.6f] %c ", 
+						 log_now () - log_ring.start, level_char[level]);
+	va_start (args, format);
+	len += vsnprintf (slot->text + len, LOG_LINE - len, format, args);
+	va_end (args);
+	
+	if (len > LOG_LINE - 1) {
+		len = LOG_LINE - 1;
+	}
+	if (slot->text[len - 1] != '\n') {
+		if (len == LOG_LINE - 1) {
+			len--;
+		}
+		slot->text[len++] = '\n';
+		slot->text[len] = '\0';
+	}
+	slot->len = len;
+	
+	__sync_synchronize ();
+	slot->seq = seq + 1;
+}
+
+/* log each line of text on its own */
+void
+log_text (int level, const char *text)
+{
+	const char *end;
+	
+	if (!log_enabled (level)) {
+		return;
+	}
+	
+	for (; *text; text = end + 1) {
+		end = strchr (text, '\n');
+		if (!end) {
+			log_write (level, "%s", text);
+			break;
+		}
+		log_write (level, "%.*s", (int) (end - text), text);
+	}
+}
+
+/*
+ * Write out what was logged since the last flush, oldest first. Only
+ * async-signal-safe calls from here on.
+ */
+void
+log_flush (void)
+{
+	unsigned long head, seq;
+	
+	if (LOG_LEVEL_NONE == log_level || __sync_lock_test_and_set (&log_ring.flushing, 1)) {
+		return;
+	}
+	
+	head = log_ring.head;
+	seq = log_ring.flushed;
+	if (head - seq > LOG_RING_SIZE) {
+		seq = head - LOG_RING_SIZE;
+	}
+	
+	for (; seq < head; seq++) {
+		struct LogSlot *slot = &log_ring.slots[seq & (LOG_RING_SIZE - 1)];
+		char text[LOG_LINE];
+		int len;
+		
+		/* still being written, or already reused by a newer line */
+		if (slot->seq != seq + 1) {
+			continue;
+		}
+		len = slot->len;
+		memcpy (text, slot->text, len);
+		__sync_synchronize ();
+		if (slot->seq != seq + 1) {
+			continue;
+		}
+		
+		if (write (log_ring.fd, text, len) < 0) {
+			break;
+		}
+	}
+	log_ring.flushed = seq;
+	
+	__sync_lock_release (&log_ring.flushing);
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_LOG_H
+#define RANDR_GUI_LOG_H
+
+/*
+ * Debug history in memory: a ring of the last LOG_RING_SIZE lines. Any
+ * thread may log without taking a lock. The lines only leave memory when
+ * the ring is flushed: at exit, on SIGUSR1, on a crash or by calling
+ * log_flush (). $GRANDR_LOG picks the level (error, warn, info, debug),
+ * $GRANDR_LOG_FILE where flushes go instead of stderr. Below the level a
+ * log call costs one compare and its arguments are not evaluated.
+ */
+enum {
+	LOG_LEVEL_NONE,
+	LOG_LEVEL_ERROR,
+	LOG_LEVEL_WARN,
+	LOG_LEVEL_INFO,
+	LOG_LEVEL_DEBUG
+};
+
+extern int log_level;
+
+#define log_enabled(level)	((level) <= log_level)
+
+#define log_at(level, ...) do { \
+	if (log_enabled (level)) { \
+		log_write ((level), __VA_ARGS__); \
+	} \
+} while (0)
+
+#define log_error(...)	log_at (LOG_LEVEL_ERROR, __VA_ARGS__)
+#define log_warn(...)	log_at (LOG_LEVEL_WARN, __VA_ARGS__)
+#define log_info(...)	log_at (LOG_LEVEL_INFO, __VA_ARGS__)
+#define log_debug(...)	log_at (LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+int log_init (void);
+void log_write (int level, const char *format, ...)
+	__attribute__ ((format (printf, 2, 3)));
+void log_text (int level, const char *text);
+void log_flush (void);
+
+#endif
@@ -31,39 +31,30 @@
 #include <gtk/gtk.h>
 #include <gdk/gdkx.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "interface.h"
 #include "support.h"
 
 #include "grandr.h"
+#include "backend.h"
+#include "trace.h"
+#include "log.h"
+#include "snapcache.h"
 
 GtkWidget *root_window;
+struct MainWidgets main_widgets;
 struct ScreenInfo *screen_info;
 GtkListStore *output_store;
 GtkListStore *mode_store;
 GtkListStore *center_store, *left_store, *right_store, *above_store, *below_store;
 GtkListStore *hotkey_store;
 
-static void
-check_server_randr_version (Display *dpy)
-{
-	int major, minor;
-	
-	if (!XRRQueryVersion (dpy, &major, &minor)) {
-		fprintf (stderr, "RandR extension missing\n");
-		exit (1);
-	}
-	
-	if (major < 1 || (major >= 1 && minor < 2)) {
-		fprintf (stderr, "Server RandR version before 1.2\n");
-		exit (1);
-	}
-}
-
 int
 main (int argc, char *argv[])
 {
 	Display *display;
+	int probe = 0;
 	int i;
 
 #ifdef ENABLE_NLS
@@ -72,9 +63,25 @@ main (int argc, char *argv[])
   textdomain (GETTEXT_PACKAGE);
 #endif
 
+	/* 
+	 * --probe: make the server re-detect outputs instead of using its current view
+	 * --trace <file>: write a Chrome trace of the startup and every apply
+	 */
+	for (i = 1; i < argc; i++) {
+		if (strcmp (argv[i], "--probe") == 0) {
+			probe = 1;
+		} else if (strcmp (argv[i], "--trace") == 0 && i + 1 < argc) {
+			trace_init (argv[++i]);
+		}
+	}
+	trace_init (NULL);
+	log_init ();
+
   g_thread_init (NULL);
   gtk_set_locale ();
+  trace_begin ("x_connect", 0);
   gtk_init (&argc, &argv);
+  trace_end ("x_connect", 0);
 
   add_pixmap_directory (PACKAGE_DATA_DIR "/" PACKAGE "/pixmaps");
 	add_pixmap_directory("pixmaps");
@@ -84,50 +91,76 @@ main (int argc, char *argv[])
    * (except popup menus), just so that you see something after building
    * the project. Delete any components that you don't want shown initially.
    */
+  trace_begin ("ui_build", 0);
   root_window = create_main_win ();
   gtk_widget_show (root_window);
+	lookup_main_widgets (&main_widgets, root_window);
 	
 	display = GDK_DISPLAY();
 	
-	check_server_randr_version (display);
+	if (!check_server_randr_version (display)) {
+		trace_end ("ui_build", 0);
+		return 1;
+	}
 	
-	screen_info = read_screen_info(display);
+	/* draw the last snapshot right away, it is checked against the server once idle */
+	if (!probe) {
+		screen_info = snapshot_cache_load (display);
+	}
+	if (!screen_info) {
+		screen_info = read_screen_info(display, probe);
+		if (!screen_info) {
+			fprintf (stderr, "cannot read the screen state\n");
+			trace_end ("ui_build", 0);
+			return 1;
+		}
+		snapshot_cache_save (screen_info);
+	}
 	
 	
 	output_store = create_output_store ();
-	set_output_store (output_store, "output_iview");
+	set_output_store (output_store, main_widgets.output_iview);
 	fill_output_store (output_store, screen_info, 1, OUTPUT_CONNECTED);
 	
 	left_store = create_output_store ();
-	set_output_store (left_store, "left_iview");
+	set_output_store (left_store, main_widgets.pos_iview[LEFT_POS]);
 	
 	right_store = create_output_store ();
-	set_output_store (right_store, "right_iview");
+	set_output_store (right_store, main_widgets.pos_iview[RIGHT_POS]);
 	
 	above_store = create_output_store ();
-	set_output_store (above_store, "above_iview");
+	set_output_store (above_store, main_widgets.pos_iview[ABOVE_POS]);
 	
 	below_store = create_output_store ();
-	set_output_store (below_store, "below_iview");
+	set_output_store (below_store, main_widgets.pos_iview[BELOW_POS]);
 	
 	center_store = create_output_store ();
-	set_output_store (center_store, "center_iview");
+	set_output_store (center_store, main_widgets.pos_iview[CENTER_POS]);
 	
 	mode_store = create_mode_store ();
-	set_mode_store (mode_store, "modes_combo");
+	set_mode_store (mode_store, main_widgets.modes_combo);
 	
-	set_basic_views (screen_info->outputs[0]);
-	set_rotation_views (screen_info->outputs[0]->cur_crtc);
-	set_output_layout (screen_info);
+	set_basic_views (&main_widgets, &screen_info->outputs[0]);
+	set_rotation_views (&main_widgets, screen_info->outputs[0].cur_crtc);
+	set_output_layout (&main_widgets, screen_info);
 	
 	hotkey_store = create_hotkey_store ();
-	set_hotkey_store (hotkey_store, HOTKEY_TREEVIEW_NAME);
+	set_hotkey_store (hotkey_store, main_widgets.hotkey_tview);
 	fill_hotkey_store (hotkey_store);
-	set_hotkeys_view (hotkey_store);
-
-	//free_screen_info(screen_info);
+	set_hotkeys_view (&main_widgets, hotkey_store);
+	
+	set_randr_event_filter (screen_info);
+	if (screen_info->map) {
+		g_idle_add (confirm_cached_screen_info, NULL);
+	}
+	trace_end ("ui_build", 0);
 	
   gtk_main ();
+	
+	unset_randr_event_filter ();
+	free_screen_info (screen_info);
+	screen_info = NULL;
+	randr_free_pixbufs ();
   return 0;
 }
 
@@ -0,0 +1,870 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * A synthetic RandR server for running the core without X or monitors.
+ * The topology comes from a text file, one item per line, # comments:
+ *
+ *   screen <w> <h> <min w> <min h> <max w> <max h>
+ *   latency <ms per round trip> <ms per request> [<ms per probe>]
+ *   mode <id> <name> <w> <h> <refresh Hz> [interlace]
+ *   crtc <id> [mode <id>] [pos <x> <y>] [rotation <1|2|4|8>]
+ *   output <id> <name> connected|disconnected [mm <w> <h>] [crtcs <id>...]
+ *          [modes <id>...] [preferred <n>] [clones <id>...] [on <crtc id>]
+ *   generate <outputs> <crtcs> <modes>
+ *
+ * generate builds a regular topology of that size instead of listing it.
+ * Every request is counted and charged the configured latency, but
+ * nothing sleeps, so runs are deterministic.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "mock.h"
+#include "screen.h"
+#include "modeset.h"
+#include "trace.h"
+
+#define MOCK_ROOT		1
+#define MOCK_ROTATIONS	(RR_Rotate_0 | RR_Rotate_90 | RR_Rotate_180 | RR_Rotate_270)
+#define MOCK_MAX_TOKENS	4096
+
+struct MockCrtc {
+	RRCrtc id;
+	int x, y;
+	RRMode mode;
+	Rotation rotation;
+	Rotation rotations;
+};
+
+struct MockOutput {
+	RROutput id;
+	char *name;
+	Connection connection;
+	unsigned long mm_width, mm_height;
+	RRCrtc crtc;
+	int ncrtc;
+	RRCrtc *crtcs;
+	int nmode, npreferred;
+	RRMode *modes;
+	int nclone;
+	RROutput *clones;
+};
+
+static struct {
+	int width, height, mm_width, mm_height;
+	int min_width, min_height, max_width, max_height;
+	int have_screen;
+	double round_trip_ms, request_ms, probe_ms;
+	Time timestamp;
+	
+	int n_mode, n_crtc, n_output;
+	XRRModeInfo *modes;
+	struct MockCrtc *crtcs;
+	struct MockOutput *outputs;
+	
+	struct MockStats stats;
+} mock;
+
+static void
+mock_cost (int requests, int round_trips)
+{
+	mock.stats.requests += requests;
+	mock.stats.round_trips += round_trips;
+	mock.stats.latency_ms += requests * mock.request_ms + round_trips * mock.round_trip_ms;
+	trace_round_trips (round_trips);
+}
+
+static struct MockCrtc *
+mock_find_crtc (RRCrtc id)
+{
+	int i;
+	
+	for (i = 0; i < mock.n_crtc; i++) {
+		if (mock.crtcs[i].id == id) {
+			return &mock.crtcs[i];
+		}
+	}
+	
+	return NULL;
+}
+
+static struct MockOutput *
+mock_find_output (RROutput id)
+{
+	int i;
+	
+	for (i = 0; i < mock.n_output; i++) {
+		if (mock.outputs[i].id == id) {
+			return &mock.outputs[i];
+		}
+	}
+	
+	return NULL;
+}
+
+static XRRModeInfo *
+mock_find_mode (RRMode id)
+{
+	int i;
+	
+	for (i = 0; i < mock.n_mode; i++) {
+		if (mock.modes[i].id == id) {
+			return &mock.modes[i];
+		}
+	}
+	
+	return NULL;
+}
+
+static int
+xid_in (XID id, const XID *list, int n)
+{
+	int i;
+	
+	for (i = 0; i < n; i++) {
+		if (list[i] == id) {
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+static XRRModeInfo *
+mock_add_mode (RRMode id, const char *name, int width, int height, double refresh, int interlace)
+{
+	XRRModeInfo *mode_info;
+	
+	mock.modes = realloc (mock.modes, sizeof (XRRModeInfo) * (mock.n_mode + 1));
+	mode_info = &mock.modes[mock.n_mode++];
+	memset (mode_info, 0, sizeof (XRRModeInfo));
+	
+	/* CVT-ish blanking, only the refresh rate it gives matters */
+	mode_info->id = id;
+	mode_info->width = width;
+	mode_info->height = height;
+	mode_info->hTotal = width + width / 5 + 32;
+	mode_info->vTotal = height + height / 30 + 3;
+	mode_info->dotClock = refresh * mode_info->hTotal * mode_info->vTotal * (interlace ? 0.5 : 1);
+	mode_info->modeFlags = interlace ? RR_Interlace : 0;
+	mode_info->name = strdup (name);
+	mode_info->nameLength = strlen (name);
+	
+	return mode_info;
+}
+
+static struct MockCrtc *
+mock_add_crtc (RRCrtc id)
+{
+	struct MockCrtc *crtc;
+	
+	mock.crtcs = realloc (mock.crtcs, sizeof (struct MockCrtc) * (mock.n_crtc + 1));
+	crtc = &mock.crtcs[mock.n_crtc++];
+	memset (crtc, 0, sizeof (struct MockCrtc));
+	crtc->id = id;
+	crtc->rotation = RR_Rotate_0;
+	crtc->rotations = MOCK_ROTATIONS;
+	
+	return crtc;
+}
+
+static struct MockOutput *
+mock_add_output (RROutput id, const char *name, Connection connection)
+{
+	struct MockOutput *output;
+	
+	mock.outputs = realloc (mock.outputs, sizeof (struct MockOutput) * (mock.n_output + 1));
+	output = &mock.outputs[mock.n_output++];
+	memset (output, 0, sizeof (struct MockOutput));
+	output->id = id;
+	output->name = strdup (name);
+	output->connection = connection;
+	
+	return output;
+}
+
+/* the screen holds every lit crtc unless the topology said otherwise */
+static void
+mock_fit_screen (void)
+{
+	int i;
+	
+	if (mock.have_screen) {
+		return;
+	}
+	
+	mock.width = 0;
+	mock.height = 0;
+	for (i = 0; i < mock.n_crtc; i++) {
+		struct MockCrtc *crtc = &mock.crtcs[i];
+		XRRModeInfo *mode_info = mock_find_mode (crtc->mode);
+		
+		if (!mode_info) {
+			continue;
+		}
+		if (crtc->x + (int) mode_info->width > mock.width) {
+			mock.width = crtc->x + mode_info->width;
+		}
+		if (crtc->y + (int) mode_info->height > mock.height) {
+			mock.height = crtc->y + mode_info->height;
+		}
+	}
+	if (mock.width < 320 || mock.height < 200) {
+		mock.width = 320;
+		mock.height = 200;
+	}
+	
+	/* 96 dpi */
+	mock.mm_width = mock.width * 254 / 960;
+	mock.mm_height = mock.height * 254 / 960;
+	mock.min_width = 320;
+	mock.min_height = 200;
+	mock.max_width = mock.width > 32768 ? mock.width : 32768;
+	mock.max_height = mock.height > 32768 ? mock.height : 32768;
+}
+
+static const int generate_sizes[][2] = {
+	{ 640, 480 }, { 800, 600 }, { 1024, 768 }, { 1280, 720 }, { 1280, 800 },
+	{ 1280, 1024 }, { 1366, 768 }, { 1440, 900 }, { 1600, 900 }, { 1680, 1050 },
+	{ 1920, 1080 }, { 1920, 1200 }, { 2560, 1440 }, { 2560, 1600 }, { 3840, 2160 }
+};
+
+#define N_GENERATE_SIZES	(sizeof (generate_sizes) / sizeof (generate_sizes[0]))
+
+/*
+ * A regular topology: n_mode modes cycling through common sizes at
+ * rising refresh rates, every output connected, able to use any crtc and
+ * to show any mode, natively one of the common sizes. The first outputs
+ * (one per crtc) are lit in a grid four monitors wide.
+ */
+int
+mock_backend_generate (int n_output, int n_crtc, int n_mode)
+{
+	int n_lit, row_height = 0;
+	int x = 0, y = 0;
+	int i, j;
+	
+	if (n_output < 1 || n_crtc < 1 || n_mode < 1) {
+		return 0;
+	}
+	
+	for (i = 0; i < n_mode; i++) {
+		const int *size = generate_sizes[i % N_GENERATE_SIZES];
+		char name[32];
+		
+		snprintf (name, sizeof (name), "%dx%d", size[0], size[1]);
+		mock_add_mode (0x1000 + i, name, size[0], size[1],
+							60 + 5 * (i / N_GENERATE_SIZES), 0);
+	}
+	
+	for (i = 0; i < n_crtc; i++) {
+		mock_add_crtc (0x100 + i);
+	}
+	
+	n_lit = n_output < n_crtc ? n_output : n_crtc;
+	for (i = 0; i < n_output; i++) {
+		struct MockOutput *output;
+		int native = (N_GENERATE_SIZES - 1 - i % N_GENERATE_SIZES) % n_mode;
+		char name[32];
+		
+		snprintf (name, sizeof (name), "OUT-%d", i);
+		output = mock_add_output (0x200 + i, name, RR_Connected);
+		output->mm_width = mock.modes[native].width * 254 / 960;
+		output->mm_height = mock.modes[native].height * 254 / 960;
+		
+		output->ncrtc = n_crtc;
+		output->crtcs = malloc (sizeof (RRCrtc) * n_crtc);
+		for (j = 0; j < n_crtc; j++) {
+			output->crtcs[j] = mock.crtcs[j].id;
+		}
+		
+		/* native mode first, it is the preferred one */
+		output->nmode = n_mode;
+		output->npreferred = 1;
+		output->modes = malloc (sizeof (RRMode) * n_mode);
+		for (j = 0; j < n_mode; j++) {
+			output->modes[j] = mock.modes[(native + j) % n_mode].id;
+		}
+		
+		if (i < n_lit) {
+			struct MockCrtc *crtc = &mock.crtcs[i];
+			
+			if (i % 4 == 0 && i) {
+				x = 0;
+				y += row_height;
+				row_height = 0;
+			}
+			crtc->mode = mock.modes[native].id;
+			crtc->x = x;
+			crtc->y = y;
+			output->crtc = crtc->id;
+			x += mock.modes[native].width;
+			if ((int) mock.modes[native].height > row_height) {
+				row_height = mock.modes[native].height;
+			}
+		}
+	}
+	
+	mock_fit_screen ();
+	
+	return 1;
+}
+
+/* read XIDs following a keyword, stops at the first token that is not one */
+static int
+parse_xid_list (char **tokens, int n_token, int *t, XID **list)
+{
+	int n = 0;
+	
+	*list = malloc (sizeof (XID) * (n_token + 1));
+	while (*t < n_token) {
+		char *end;
+		unsigned long id = strtoul (tokens[*t], &end, 0);
+		
+		if (*end || end == tokens[*t]) {
+			break;
+		}
+		(*list)[n++] = id;
+		(*t)++;
+	}
+	
+	return n;
+}
+
+static int
+parse_output (char **tokens, int n_token, FILE *err, int line)
+{
+	struct MockOutput *output;
+	Connection connection;
+	int t;
+	
+	if (n_token < 4) {
+		fprintf (err, "line %d: output <id> <name> connected|disconnected ...\n", line);
+		return 0;
+	}
+	connection = strcmp (tokens[3], "connected") == 0 ? RR_Connected : RR_Disconnected;
+	output = mock_add_output (strtoul (tokens[1], NULL, 0), tokens[2], connection);
+	
+	for (t = 4; t < n_token; ) {
+		const char *key = tokens[t++];
+		
+		if (strcmp (key, "mm") == 0 && t + 1 < n_token) {
+			output->mm_width = strtoul (tokens[t], NULL, 0);
+			output->mm_height = strtoul (tokens[t + 1], NULL, 0);
+			t += 2;
+		} else if (strcmp (key, "crtcs") == 0) {
+			free (output->crtcs);
+			output->ncrtc = parse_xid_list (tokens, n_token, &t, &output->crtcs);
+		} else if (strcmp (key, "modes") == 0) {
+			free (output->modes);
+			output->nmode = parse_xid_list (tokens, n_token, &t, &output->modes);
+		} else if (strcmp (key, "clones") == 0) {
+			free (output->clones);
+			output->nclone = parse_xid_list (tokens, n_token, &t, &output->clones);
+		} else if (strcmp (key, "preferred") == 0 && t < n_token) {
+			output->npreferred = atoi (tokens[t++]);
+		} else if (strcmp (key, "on") == 0 && t < n_token) {
+			output->crtc = strtoul (tokens[t++], NULL, 0);
+		} else {
+			fprintf (err, "line %d: unknown output field %s\n", line, key);
+			return 0;
+		}
+	}
+	if (output->npreferred > output->nmode) {
+		output->npreferred = output->nmode;
+	}
+	
+	return 1;
+}
+
+static int
+parse_crtc (char **tokens, int n_token, FILE *err, int line)
+{
+	struct MockCrtc *crtc;
+	int t;
+	
+	if (n_token < 2) {
+		fprintf (err, "line %d: crtc <id> ...\n", line);
+		return 0;
+	}
+	crtc = mock_add_crtc (strtoul (tokens[1], NULL, 0));
+	
+	for (t = 2; t < n_token; ) {
+		const char *key = tokens[t++];
+		
+		if (strcmp (key, "mode") == 0 && t < n_token) {
+			crtc->mode = strtoul (tokens[t++], NULL, 0);
+		} else if (strcmp (key, "pos") == 0 && t + 1 < n_token) {
+			crtc->x = atoi (tokens[t]);
+			crtc->y = atoi (tokens[t + 1]);
+			t += 2;
+		} else if (strcmp (key, "rotation") == 0 && t < n_token) {
+			crtc->rotation = atoi (tokens[t++]);
+		} else {
+			fprintf (err, "line %d: unknown crtc field %s\n", line, key);
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+static int
+parse_line (char **tokens, int n_token, FILE *err, int line)
+{
+	const char *kind = tokens[0];
+	
+	if (strcmp (kind, "screen") == 0 && n_token == 7) {
+		mock.width = atoi (tokens[1]);
+		mock.height = atoi (tokens[2]);
+		mock.min_width = atoi (tokens[3]);
+		mock.min_height = atoi (tokens[4]);
+		mock.max_width = atoi (tokens[5]);
+		mock.max_height = atoi (tokens[6]);
+		mock.mm_width = mock.width * 254 / 960;
+		mock.mm_height = mock.height * 254 / 960;
+		mock.have_screen = 1;
+	} else if (strcmp (kind, "latency") == 0 && n_token >= 3) {
+		mock.round_trip_ms = atof (tokens[1]);
+		mock.request_ms = atof (tokens[2]);
+		mock.probe_ms = n_token > 3 ? atof (tokens[3]) : 0;
+	} else if (strcmp (kind, "mode") == 0 && n_token >= 6) {
+		mock_add_mode (strtoul (tokens[1], NULL, 0), tokens[2], atoi (tokens[3]),
+							atoi (tokens[4]), atof (tokens[5]),
+							n_token > 6 && strcmp (tokens[6], "interlace") == 0);
+	} else if (strcmp (kind, "crtc") == 0) {
+		return parse_crtc (tokens, n_token, err, line);
+	} else if (strcmp (kind, "output") == 0) {
+		return parse_output (tokens, n_token, err, line);
+	} else if (strcmp (kind, "generate") == 0 && n_token == 4) {
+		return mock_backend_generate (atoi (tokens[1]), atoi (tokens[2]), atoi (tokens[3]));
+	} else {
+		fprintf (err, "line %d: cannot make sense of %s\n", line, kind);
+		return 0;
+	}
+	
+	return 1;
+}
+
+/* load the topology in path, 0 after complaining on err if it is broken */
+int
+mock_backend_load (const char *path, FILE *err)
+{
+	FILE *file;
+	char *buf = NULL;
+	size_t size = 0;
+	char **tokens;
+	int line = 0;
+	int ok = 1;
+	
+	file = fopen (path, "r");
+	if (!file) {
+		fprintf (err, "%s: cannot open mock topology\n", path);
+		return 0;
+	}
+	
+	mock_backend_free ();
+	tokens = malloc (sizeof (char *) * MOCK_MAX_TOKENS);
+	
+	while (ok && getline (&buf, &size, file) > 0) {
+		char *token, *save;
+		int n_token = 0;
+		
+		line++;
+		if ((token = strchr (buf, '#'))) {
+			*token = '\0';
+		}
+		for (token = strtok_r (buf, " \t\r\n", &save); token && n_token < MOCK_MAX_TOKENS;
+			  token = strtok_r (NULL, " \t\r\n", &save)) {
+			tokens[n_token++] = token;
+		}
+		if (n_token) {
+			ok = parse_line (tokens, n_token, err, line);
+		}
+	}
+	
+	free (tokens);
+	free (buf);
+	fclose (file);
+	
+	if (ok && (!mock.n_crtc || !mock.n_output)) {
+		fprintf (err, "%s: a topology needs crtcs and outputs\n", path);
+		ok = 0;
+	}
+	if (!ok) {
+		fprintf (err, "%s: bad mock topology\n", path);
+		mock_backend_free ();
+		return 0;
+	}
+	
+	mock_fit_screen ();
+	
+	return 1;
+}
+
+void
+mock_backend_free (void)
+{
+	int i;
+	
+	for (i = 0; i < mock.n_mode; i++) {
+		free (mock.modes[i].name);
+	}
+	for (i = 0; i < mock.n_output; i++) {
+		free (mock.outputs[i].name);
+		free (mock.outputs[i].crtcs);
+		free (mock.outputs[i].modes);
+		free (mock.outputs[i].clones);
+	}
+	free (mock.modes);
+	free (mock.crtcs);
+	free (mock.outputs);
+	memset (&mock, 0, sizeof (mock));
+}
+
+void
+mock_backend_stats (struct MockStats *stats)
+{
+	*stats = mock.stats;
+}
+
+void
+mock_backend_reset_stats (void)
+{
+	memset (&mock.stats, 0, sizeof (mock.stats));
+}
+
+static void
+mock_get_screen (Display *dpy, Window *root, int *width, int *height,
+					  int *mm_width, int *mm_height)
+{
+	*root = MOCK_ROOT;
+	*width = mock.width;
+	*height = mock.height;
+	*mm_width = mock.mm_width;
+	*mm_height = mock.mm_height;
+}
+
+static void
+mock_get_size_range (Display *dpy, Window root, int *min_width, int *min_height,
+							int *max_width, int *max_height)
+{
+	mock_cost (1, 1);
+	*min_width = mock.min_width;
+	*min_height = mock.min_height;
+	*max_width = mock.max_width;
+	*max_height = mock.max_height;
+}
+
+static XRRScreenResources *
+mock_get_resources (Display *dpy, Window root, int probe, struct Arena *arena)
+{
+	XRRScreenResources *res;
+	int i;
+	
+	mock_cost (1, 1);
+	if (probe) {
+		mock.stats.latency_ms += mock.probe_ms;
+	}
+	
+	res = arena_alloc (arena, sizeof (XRRScreenResources));
+	if (!res) {
+		return NULL;
+	}
+	res->timestamp = mock.timestamp;
+	res->configTimestamp = 1;
+	res->ncrtc = mock.n_crtc;
+	res->noutput = mock.n_output;
+	res->nmode = mock.n_mode;
+	res->crtcs = arena_alloc (arena, sizeof (RRCrtc) * (mock.n_crtc + 1));
+	res->outputs = arena_alloc (arena, sizeof (RROutput) * (mock.n_output + 1));
+	res->modes = arena_memdup (arena, mock.modes, sizeof (XRRModeInfo) * mock.n_mode);
+	if (!res->crtcs || !res->outputs || !res->modes) {
+		return NULL;
+	}
+	
+	for (i = 0; i < mock.n_crtc; i++) {
+		res->crtcs[i] = mock.crtcs[i].id;
+	}
+	for (i = 0; i < mock.n_output; i++) {
+		res->outputs[i] = mock.outputs[i].id;
+	}
+	for (i = 0; i < mock.n_mode; i++) {
+		res->modes[i].name = arena_memdup (arena, mock.modes[i].name,
+													  mock.modes[i].nameLength + 1);
+		if (!res->modes[i].name) {
+			return NULL;
+		}
+	}
+	
+	return res;
+}
+
+/* laid out like the x backend builds it: possible, then room for as many outputs */
+static XRRCrtcInfo *
+mock_crtc_info (struct MockCrtc *crtc, struct Arena *arena)
+{
+	XRRCrtcInfo *info;
+	XRRModeInfo *mode_info = mock_find_mode (crtc->mode);
+	int i;
+	
+	info = arena_alloc (arena, sizeof (XRRCrtcInfo) + 2 * mock.n_output * sizeof (RROutput));
+	if (!info) {
+		return NULL;
+	}
+	info->timestamp = mock.timestamp;
+	info->x = crtc->x;
+	info->y = crtc->y;
+	info->mode = crtc->mode;
+	info->rotation = crtc->rotation;
+	info->rotations = crtc->rotations;
+	if (mode_info) {
+		info->width = mode_width (mode_info, crtc->rotation);
+		info->height = mode_height (mode_info, crtc->rotation);
+	}
+	info->possible = (RROutput *) (info + 1);
+	
+	for (i = 0; i < mock.n_output; i++) {
+		struct MockOutput *output = &mock.outputs[i];
+		
+		if (xid_in (crtc->id, output->crtcs, output->ncrtc)) {
+			info->possible[info->npossible++] = output->id;
+		}
+	}
+	info->outputs = info->possible + info->npossible;
+	for (i = 0; crtc->mode && i < mock.n_output; i++) {
+		if (mock.outputs[i].crtc == crtc->id) {
+			info->outputs[info->noutput++] = mock.outputs[i].id;
+		}
+	}
+	
+	return info;
+}
+
+static XRROutputInfo *
+mock_output_info (struct MockOutput *output, struct Arena *arena)
+{
+	XRROutputInfo *info;
+	
+	info = arena_alloc (arena, sizeof (XRROutputInfo));
+	if (!info) {
+		return NULL;
+	}
+	info->timestamp = mock.timestamp;
+	info->crtc = output->crtc;
+	info->name = arena_memdup (arena, output->name, strlen (output->name) + 1);
+	info->nameLen = strlen (output->name);
+	info->mm_width = output->mm_width;
+	info->mm_height = output->mm_height;
+	info->connection = output->connection;
+	info->ncrtc = output->ncrtc;
+	info->crtcs = arena_memdup (arena, output->crtcs, sizeof (RRCrtc) * output->ncrtc);
+	info->nclone = output->nclone;
+	info->clones = arena_memdup (arena, output->clones, sizeof (RROutput) * output->nclone);
+	info->nmode = output->nmode;
+	info->npreferred = output->npreferred;
+	info->modes = arena_memdup (arena, output->modes, sizeof (RRMode) * output->nmode);
+	if (!info->name || !info->crtcs || !info->clones || !info->modes) {
+		return NULL;
+	}
+	
+	return info;
+}
+
+static void
+mock_get_infos (struct ScreenInfo *screen_info, struct Arena *arena,
+					 XRRCrtcInfo **crtc_infos, XRROutputInfo **output_infos)
+{
+	XRRScreenResources *res = screen_info->res;
+	int i;
+	
+	/* pipelined like the x backend: one request each, one round trip */
+	mock_cost (res->ncrtc + (output_infos ? res->noutput : 0), 1);
+	screen_info->round_trips++;
+	
+	for (i = 0; i < res->ncrtc; i++) {
+		struct MockCrtc *crtc = mock_find_crtc (res->crtcs[i]);
+		
+		crtc_infos[i] = crtc ? mock_crtc_info (crtc, arena) : NULL;
+	}
+	for (i = 0; output_infos && i < res->noutput; i++) {
+		struct MockOutput *output = mock_find_output (res->outputs[i]);
+		
+		output_infos[i] = output ? mock_output_info (output, arena) : NULL;
+	}
+}
+
+static XRROutputInfo *
+mock_get_output_info (Display *dpy, XRRScreenResources *res, RROutput id,
+							 struct Arena *arena)
+{
+	struct MockOutput *output = mock_find_output (id);
+	
+	mock_cost (1, 1);
+	
+	return output ? mock_output_info (output, arena) : NULL;
+}
+
+/* no events ever come from the mock server */
+static int
+mock_select_events (Display *dpy, Window root)
+{
+	mock_cost (1, 0);
+	
+	return -1;
+}
+
+static void
+mock_grab (Display *dpy)
+{
+	mock_cost (1, 0);
+}
+
+static void
+mock_ungrab (Display *dpy)
+{
+	/* XUngrabServer + XSync */
+	mock_cost (1, 1);
+}
+
+/* check a SetCrtcConfig the way the server would, returns an RRSetConfig status */
+static int
+mock_set_crtc (struct ModesetStep *step)
+{
+	struct MockCrtc *crtc = mock_find_crtc (step->crtc->id);
+	XRRModeInfo *mode_info = NULL;
+	int i;
+	
+	if (!crtc) {
+		step->error_code = BadValue;
+		return RRSetConfigFailed;
+	}
+	if (step->mode_id) {
+		mode_info = mock_find_mode (step->mode_id);
+		if (!mode_info || (crtc->rotations & step->rotation) != step->rotation ||
+			 step->x + mode_width (mode_info, step->rotation) > mock.width ||
+			 step->y + mode_height (mode_info, step->rotation) > mock.height) {
+			step->error_code = BadMatch;
+			return RRSetConfigFailed;
+		}
+	}
+	for (i = 0; i < step->noutput; i++) {
+		struct MockOutput *output = mock_find_output (step->outputs[i]);
+		
+		if (!output || !xid_in (crtc->id, output->crtcs, output->ncrtc) ||
+			 !xid_in (step->mode_id, output->modes, output->nmode)) {
+			step->error_code = BadMatch;
+			return RRSetConfigFailed;
+		}
+	}
+	
+	for (i = 0; i < mock.n_output; i++) {
+		if (mock.outputs[i].crtc == crtc->id) {
+			mock.outputs[i].crtc = None;
+		}
+	}
+	for (i = 0; i < step->noutput; i++) {
+		mock_find_output (step->outputs[i])->crtc = crtc->id;
+	}
+	crtc->mode = step->mode_id;
+	crtc->x = step->x;
+	crtc->y = step->y;
+	crtc->rotation = step->rotation;
+	
+	return RRSetConfigSuccess;
+}
+
+static int
+mock_run_plan (struct ModesetPlan *plan)
+{
+	int ok = 1;
+	int i;
+	
+	/* all steps are sent before the first reply is read */
+	mock_cost (plan->n_step, 1);
+	
+	for (i = 0; i < plan->n_step; i++) {
+		struct ModesetStep *step = &plan->steps[i];
+		
+		step->error_code = Success;
+		if (STEP_SCREEN_SIZE == step->type) {
+			if (plan->width < mock.min_width || plan->width > mock.max_width ||
+				 plan->height < mock.min_height || plan->height > mock.max_height) {
+				step->error_code = BadValue;
+				step->status = RRSetConfigFailed;
+			} else {
+				mock.width = plan->width;
+				mock.height = plan->height;
+				mock.mm_width = plan->mmWidth;
+				mock.mm_height = plan->mmHeight;
+				step->status = RRSetConfigSuccess;
+			}
+		} else {
+			step->status = mock_set_crtc (step);
+		}
+		
+		if (RRSetConfigSuccess != step->status) {
+			ok = 0;
+		} else if (STEP_SET_CRTC == step->type) {
+			step->crtc->changed = 0;
+		}
+	}
+	mock.timestamp++;
+	
+	return ok;
+}
+
+const struct RandrBackend mock_backend = {
+	"mock",
+	mock_get_screen,
+	mock_get_size_range,
+	mock_get_resources,
+	mock_get_infos,
+	mock_get_output_info,
+	mock_select_events,
+	mock_grab,
+	mock_ungrab,
+	mock_run_plan
+};
+
+/* 
+ * Use the synthetic server when $GRANDR_MOCK names a topology file, the
+ * real one otherwise. Returns 0 after complaining on err if the topology
+ * cannot be loaded.
+ */
+int
+mock_backend_init (FILE *err)
+{
+	const char *topology = getenv ("GRANDR_MOCK");
+	
+	if (!topology || !*topology) {
+		randr_backend = &x_backend;
+		return 1;
+	}
+	
+	if (!mock_backend_load (topology, err)) {
+		return 0;
+	}
+	randr_backend = &mock_backend;
+	
+	return 1;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_MOCK_H
+#define RANDR_GUI_MOCK_H
+
+#include <stdio.h>
+
+#include "backend.h"
+
+/* what the core asked of the synthetic server so far */
+struct MockStats {
+	long requests;
+	long round_trips;
+	double latency_ms;		/* simulated, nothing actually sleeps */
+};
+
+extern const struct RandrBackend mock_backend;
+
+int mock_backend_init (FILE *err);
+int mock_backend_load (const char *path, FILE *err);
+int mock_backend_generate (int n_output, int n_crtc, int n_mode);
+void mock_backend_stats (struct MockStats *stats);
+void mock_backend_reset_stats (void);
+void mock_backend_free (void);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * Per-snapshot mode table. Each mode of the screen resources gets its
+ * size, refresh rate, flags and label computed once, plus its rank in a
+ * resolution/refresh order so that per-output lists are plain index
+ * arrays that can be walked in display order.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "modedb.h"
+
+#define MODE_LABEL_LEN	64
+
+/* qsort () comparators over arrays of struct ModeEntry pointers */
+static int
+compare_entries (const void *a, const void *b)
+{
+	const struct ModeEntry *ea = *(const struct ModeEntry * const *) a;
+	const struct ModeEntry *eb = *(const struct ModeEntry * const *) b;
+	long area_a = (long) ea->width * ea->height;
+	long area_b = (long) eb->width * eb->height;
+	
+	if (area_a != area_b) {
+		return area_a > area_b ? -1 : 1;
+	}
+	if (ea->width != eb->width) {
+		return ea->width > eb->width ? -1 : 1;
+	}
+	if (ea->refresh != eb->refresh) {
+		return ea->refresh > eb->refresh ? -1 : 1;
+	}
+	if (ea->flags != eb->flags) {
+		return ea->flags < eb->flags ? -1 : 1;
+	}
+	
+	return (ea->id > eb->id) - (ea->id < eb->id);
+}
+
+static int
+mode_entry_init (struct ModeEntry *entry, XRRModeInfo *mode_info, struct Arena *arena)
+{
+	double refresh = 0;
+	
+	if (mode_info->hTotal && mode_info->vTotal) {
+		refresh = (double) mode_info->dotClock / 
+					 ((double) mode_info->hTotal * (double) mode_info->vTotal);
+	}
+	
+	entry->id = mode_info->id;
+	entry->info = mode_info;
+	entry->width = mode_info->width;
+	entry->height = mode_info->height;
+	entry->flags = 0;
+	if (mode_info->modeFlags & RR_Interlace) {
+		entry->flags |= MODE_INTERLACE;
+		refresh *= 2;
+	}
+	if (mode_info->modeFlags & RR_DoubleScan) {
+		entry->flags |= MODE_DOUBLESCAN;
+		refresh /= 2;
+	}
+	entry->refresh = refresh;
+	
+	/* the label only shows a tenth of a Hz, so neither can the key */
+	entry->key = ((unsigned long long) entry->width << 40) |
+					 ((unsigned long long) entry->height << 24) |
+					 ((unsigned long long) (refresh * 10 + 0.5) << 2) |
+					 entry->flags;
+	
+	entry->label = arena_alloc (arena, MODE_LABEL_LEN);
+	if (!entry->label) {
+		return 0;
+	}
+	snprintf (entry->label, MODE_LABEL_LEN, "%s%6.1fHz%s", mode_info->name, refresh,
+				 entry->flags & MODE_INTERLACE ? " (i)" : "");
+	
+	return 1;
+}
+
+/* 
+ * The table and its labels live in arena and go away with it. Returns 0
+ * if memory ran out.
+ */
+int
+mode_db_init (struct ModeDb *db, XRRScreenResources *res, struct Arena *arena)
+{
+	struct ModeEntry **by_size;
+	int i;
+	
+	db->n_mode = res->nmode;
+	db->entries = arena_alloc (arena, sizeof (struct ModeEntry) * (res->nmode + 1));
+	db->sorted = arena_alloc (arena, sizeof (int) * (res->nmode + 1));
+	if (!db->entries || !db->sorted) {
+		return 0;
+	}
+	by_size = malloc (sizeof (struct ModeEntry *) * (res->nmode + 1));
+	if (!by_size) {
+		return 0;
+	}
+	
+	for (i = 0; i < res->nmode; i++) {
+		if (!mode_entry_init (&db->entries[i], &res->modes[i], arena)) {
+			free (by_size);
+			return 0;
+		}
+		by_size[i] = &db->entries[i];
+	}
+	
+	qsort (by_size, db->n_mode, sizeof (struct ModeEntry *), compare_entries);
+	
+	for (i = 0; i < db->n_mode; i++) {
+		db->sorted[i] = by_size[i] - db->entries;
+		by_size[i]->rank = i;
+	}
+	free (by_size);
+	
+	return 1;
+}
+
+static int
+compare_rank (const void *a, const void *b)
+{
+	const struct ModeEntry *ea = *(const struct ModeEntry * const *) a;
+	const struct ModeEntry *eb = *(const struct ModeEntry * const *) b;
+	
+	return ea->rank - eb->rank;
+}
+
+/*
+ * The modes of an output as entry indices in display order, with
+ * duplicates dropped (a preferred duplicate wins). *preferred is the
+ * position of the first preferred mode in the list, -1 for none. Returns
+ * the length of the list stored in *modes, allocated from arena, or -1 if
+ * memory ran out.
+ */
+int
+mode_db_output_list (const struct ModeDb *db, const struct XidHash *mode_hash,
+							XRROutputInfo *info, struct Arena *arena, int **modes, int *preferred)
+{
+	const struct ModeEntry **by_rank;
+	int *list;
+	int preferred_index = -1;
+	int n = 0, n_unique = 0;
+	int i;
+	
+	list = arena_alloc (arena, sizeof (int) * (info->nmode + 1));
+	by_rank = malloc (sizeof (struct ModeEntry *) * (info->nmode + 1));
+	if (!list || !by_rank) {
+		free (by_rank);
+		return -1;
+	}
+	for (i = 0; i < info->nmode; i++) {
+		int index = xid_hash_lookup (mode_hash, info->modes[i]);
+		
+		if (index < 0) {
+			continue;
+		}
+		if (i < info->npreferred && preferred_index < 0) {
+			preferred_index = index;
+		}
+		by_rank[n++] = &db->entries[index];
+	}
+	
+	qsort (by_rank, n, sizeof (struct ModeEntry *), compare_rank);
+	for (i = 0; i < n; i++) {
+		list[i] = by_rank[i] - db->entries;
+	}
+	free (by_rank);
+	
+	*preferred = -1;
+	for (i = 0; i < n; i++) {
+		if (n_unique && db->entries[list[n_unique - 1]].key == db->entries[list[i]].key) {
+			if (list[i] != preferred_index) {
+				continue;
+			}
+			n_unique--;
+		}
+		if (list[i] == preferred_index) {
+			*preferred = n_unique;
+		}
+		list[n_unique++] = list[i];
+	}
+	
+	*modes = list;
+	
+	return n_unique;
+}
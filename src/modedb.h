@@ -0,0 +1,60 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_MODEDB_H
+#define RANDR_GUI_MODEDB_H
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+
+#include "arena.h"
+#include "xidhash.h"
+
+#define MODE_INTERLACE		(1 << 0)
+#define MODE_DOUBLESCAN		(1 << 1)
+
+/* 
+ * What the GUI and the mode pickers want to know about a mode, worked
+ * out once per snapshot instead of from the raw timings on every use.
+ */
+struct ModeEntry {
+	RRMode id;
+	XRRModeInfo *info;
+	int width, height;
+	double refresh;		/* Hz, 0 when the timings are unknown */
+	int flags;			/* MODE_INTERLACE, MODE_DOUBLESCAN */
+	unsigned long long key;	/* equal for modes nobody can tell apart */
+	int rank;			/* position in ModeDb.sorted */
+	char *label;		/* "1024x768  60.0Hz" */
+};
+
+struct ModeDb {
+	int n_mode;
+	struct ModeEntry *entries;	/* parallel to res->modes */
+	int *sorted;			/* entries by resolution, then refresh, largest first */
+};
+
+int mode_db_init (struct ModeDb *db, XRRScreenResources *res, struct Arena *arena);
+int mode_db_output_list (const struct ModeDb *db, const struct XidHash *mode_hash,
+								 XRROutputInfo *info, struct Arena *arena, 
+								 int **modes, int *preferred);
+
+#endif
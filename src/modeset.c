@@ -0,0 +1,304 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "modeset.h"
+#include "backend.h"
+#include "trace.h"
+#include <stdlib.h>
+
+static int
+crtc_is_on (int noutput, RRMode mode_id)
+{
+	return noutput > 0 && mode_id != None;
+}
+
+/* does the pending configuration of crtc drive output */
+static int
+crtc_has_output (struct CrtcInfo *crtc_info, RROutput output_id)
+{
+	struct OutputInfo *output_info;
+	
+	output_info = get_output_info_by_xid (crtc_info->screen_info, output_id);
+	
+	return output_info && output_info->cur_crtc == crtc_info;
+}
+
+/* has an output driven by the live crtc been handed over to another crtc */
+static int
+crtc_loses_output (struct CrtcInfo *crtc_info)
+{
+	XRRCrtcInfo *live = crtc_info->info;
+	int i;
+	
+	for (i = 0; i < live->noutput; i++) {
+		if (!crtc_has_output (crtc_info, live->outputs[i])) {
+			return 1;
+		}
+	}
+	
+	return 0;
+}
+
+/* compare the pending state of a crtc with the live one */
+int
+crtc_state_changed (struct CrtcInfo *crtc_info)
+{
+	XRRCrtcInfo *live = crtc_info->info;
+	int want_on, is_on;
+	
+	want_on = crtc_is_on (crtc_info->cur_noutput, crtc_info->cur_mode_id);
+	is_on = crtc_is_on (live->noutput, live->mode);
+	
+	if (want_on != is_on) {
+		return 1;
+	}
+	if (!want_on) {
+		return 0;
+	}
+	
+	if (crtc_info->cur_x != live->x ||
+		 crtc_info->cur_y != live->y ||
+		 crtc_info->cur_mode_id != live->mode ||
+		 crtc_info->cur_rotation != live->rotation ||
+		 crtc_info->cur_noutput != live->noutput) {
+		return 1;
+	}
+	
+	return crtc_loses_output (crtc_info);
+}
+
+/* would the live configuration of the crtc stick out of a width x height screen */
+static int
+crtc_live_fits (struct CrtcInfo *crtc_info, int width, int height)
+{
+	XRRCrtcInfo *live = crtc_info->info;
+	XRRModeInfo *mode_info;
+	
+	mode_info = find_mode_by_xid (crtc_info->screen_info, live->mode);
+	if (!mode_info) {
+		return 1;
+	}
+	
+	return live->x + mode_width (mode_info, live->rotation) <= width &&
+			 live->y + mode_height (mode_info, live->rotation) <= height;
+}
+
+static struct ModesetStep *
+plan_add_step (struct ModesetPlan *plan, int type, struct CrtcInfo *crtc_info)
+{
+	struct ModesetStep *step;
+	
+	step = &plan->steps[plan->n_step++];
+	step->type = type;
+	step->crtc = crtc_info;
+	step->x = 0;
+	step->y = 0;
+	step->mode_id = None;
+	step->rotation = RR_Rotate_0;
+	step->noutput = 0;
+	step->outputs = NULL;
+	step->status = RRSetConfigSuccess;
+	step->error_code = Success;
+	
+	return step;
+}
+
+/* resolve the crtc configuration and its output list into the step */
+static void
+plan_add_set_step (struct ModesetPlan *plan, struct CrtcInfo *crtc_info, int *n_plan_output)
+{
+	struct ScreenInfo *screen_info = plan->screen_info;
+	struct ModesetStep *step;
+	int i;
+	
+	step = plan_add_step (plan, STEP_SET_CRTC, crtc_info);
+	step->x = crtc_info->cur_x;
+	step->y = crtc_info->cur_y;
+	step->mode_id = crtc_info->cur_mode_id;
+	step->rotation = crtc_info->cur_rotation;
+	step->outputs = plan->outputs + *n_plan_output;
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct OutputInfo *output_info = &screen_info->outputs[i];
+		
+		if (output_info->cur_crtc == crtc_info) {
+			step->outputs[step->noutput++] = output_info->id;
+		}
+	}
+	
+	*n_plan_output += step->noutput;
+}
+
+/*
+ * Work out the requests needed to reach the pending configuration:
+ * first switch off every crtc that goes away, gives an output to another
+ * crtc or would not fit in the new screen, then resize the screen if
+ * needed and finally program every crtc whose state differs from the
+ * live one. Untouched crtcs get no request at all, so their monitors
+ * keep their picture. set_screen_size() must have been called first.
+ * Returns NULL if memory ran out.
+ */
+struct ModesetPlan *
+modeset_plan_new (struct ScreenInfo *screen_info)
+{
+	struct ModesetPlan *plan;
+	Window root;
+	int live_width, live_height, live_mmWidth, live_mmHeight;
+	int *disabled;
+	int n_plan_output = 0;
+	int i;
+	
+	randr_backend->get_screen (screen_info->dpy, &root, &live_width, &live_height,
+										&live_mmWidth, &live_mmHeight);
+	
+	plan = malloc (sizeof (struct ModesetPlan));
+	if (!plan) {
+		return NULL;
+	}
+	plan->screen_info = screen_info;
+	plan->n_step = 0;
+	plan->steps = malloc (sizeof (struct ModesetStep) * (2 * screen_info->n_crtc + 1));
+	plan->outputs = malloc (sizeof (xcb_randr_output_t) * 
+									(screen_info->n_output ? screen_info->n_output : 1));
+	disabled = calloc (screen_info->n_crtc ? screen_info->n_crtc : 1, sizeof (int));
+	if (!plan->steps || !plan->outputs || !disabled) {
+		free (disabled);
+		modeset_plan_free (plan);
+		return NULL;
+	}
+	plan->width = screen_info->cur_width;
+	plan->height = screen_info->cur_height;
+	plan->mmWidth = screen_info->cur_mmWidth;
+	plan->mmHeight = screen_info->cur_mmHeight;
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		struct CrtcInfo *crtc_info = &screen_info->crtcs[i];
+		
+		crtc_info->changed = crtc_state_changed (crtc_info);
+		if (!crtc_info->changed || 
+			 !crtc_is_on (crtc_info->info->noutput, crtc_info->info->mode)) {
+			continue;
+		}
+		
+		if (!crtc_is_on (crtc_info->cur_noutput, crtc_info->cur_mode_id) ||
+			 crtc_loses_output (crtc_info) ||
+			 !crtc_live_fits (crtc_info, plan->width, plan->height)) {
+			plan_add_step (plan, STEP_DISABLE, crtc_info);
+			disabled[i] = 1;
+		}
+	}
+	
+	if (plan->width != live_width || plan->height != live_height ||
+		 plan->mmWidth != live_mmWidth || plan->mmHeight != live_mmHeight) {
+		plan_add_step (plan, STEP_SCREEN_SIZE, NULL);
+	}
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		struct CrtcInfo *crtc_info = &screen_info->crtcs[i];
+		
+		if (!crtc_info->changed && !disabled[i]) {
+			continue;
+		}
+		if (crtc_is_on (crtc_info->cur_noutput, crtc_info->cur_mode_id)) {
+			plan_add_set_step (plan, crtc_info, &n_plan_output);
+		} else if (!disabled[i]) {
+			/* nothing to switch on, make sure it is off */
+			plan_add_step (plan, STEP_DISABLE, crtc_info);
+		}
+	}
+	
+	free (disabled);
+	
+	return plan;
+}
+
+/* send the plan through the backend, 1 when every step succeeded */
+int
+modeset_plan_run (struct ModesetPlan *plan)
+{
+	int ok;
+	
+	trace_begin ("modeset_plan_run", 0);
+	ok = randr_backend->run_plan (plan);
+	trace_end ("modeset_plan_run", 0);
+	
+	return ok;
+}
+
+/* report the steps of a plan that has been run and failed */
+void
+modeset_plan_print_errors (struct ModesetPlan *plan, FILE *file)
+{
+	int i;
+	
+	for (i = 0; i < plan->n_step; i++) {
+		struct ModesetStep *step = &plan->steps[i];
+		
+		if (RRSetConfigSuccess == step->status) {
+			continue;
+		}
+		
+		if (STEP_SCREEN_SIZE == step->type) {
+			fprintf (file, "screen size %dx%d: X error %d\n", 
+						plan->width, plan->height, step->error_code);
+		} else {
+			fprintf (file, "crtc 0x%lx: %s failed, status %d, X error %d\n",
+						step->crtc->id, 
+						STEP_DISABLE == step->type ? "disable" : "set config",
+						step->status, step->error_code);
+		}
+	}
+}
+
+void
+modeset_plan_print (struct ModesetPlan *plan, FILE *file)
+{
+	int i;
+	
+	fprintf (file, "modeset plan: %d step(s)\n", plan->n_step);
+	for (i = 0; i < plan->n_step; i++) {
+		struct ModesetStep *step = &plan->steps[i];
+		struct CrtcInfo *crtc_info = step->crtc;
+		
+		switch (step->type) {
+			case STEP_DISABLE:
+				fprintf (file, "  disable crtc 0x%lx\n", crtc_info->id);
+				break;
+			case STEP_SCREEN_SIZE:
+				fprintf (file, "  screen size %dx%d (%dx%d mm)\n", 
+							plan->width, plan->height, plan->mmWidth, plan->mmHeight);
+				break;
+			case STEP_SET_CRTC:
+				fprintf (file, "  set crtc 0x%lx mode 0x%lx +%d+%d rotation %d, %d output(s)\n",
+							crtc_info->id, step->mode_id, step->x, step->y,
+							step->rotation, step->noutput);
+				break;
+		}
+	}
+}
+
+void
+modeset_plan_free (struct ModesetPlan *plan)
+{
+	free (plan->steps);
+	free (plan->outputs);
+	free (plan);
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_MODESET_H
+#define RANDR_GUI_MODESET_H
+
+#include <stdio.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/randr.h>
+#include "screen.h"
+
+enum {
+	STEP_DISABLE,		/* turn a crtc off */
+	STEP_SCREEN_SIZE,	/* XRRSetScreenSize to the plan's size */
+	STEP_SET_CRTC		/* program a crtc with its cur_* state */
+};
+
+struct ModesetStep {
+	int type;
+	struct CrtcInfo *crtc;	/* NULL for STEP_SCREEN_SIZE */
+	
+	/* STEP_SET_CRTC: the crtc configuration, resolved when planning */
+	int x, y;
+	RRMode mode_id;
+	Rotation rotation;
+	int noutput;
+	xcb_randr_output_t *outputs;	/* points into ModesetPlan::outputs */
+	
+	/* filled in by modeset_plan_run () */
+	int status;			/* RRSetConfig* */
+	int error_code;		/* X error, Success if none */
+};
+
+/* 
+ * The smallest ordered list of requests taking the server from its live
+ * state (CrtcInfo::info) to the pending one (CrtcInfo::cur_*). Running
+ * it only sends requests, so it is cheap enough to do under a server grab.
+ */
+struct ModesetPlan {
+	struct ScreenInfo *screen_info;
+	int n_step;
+	struct ModesetStep *steps;
+	xcb_randr_output_t *outputs;
+	
+	int width, height;
+	int mmWidth, mmHeight;
+};
+
+int crtc_state_changed (struct CrtcInfo *crtc_info);
+struct ModesetPlan *modeset_plan_new (struct ScreenInfo *screen_info);
+int modeset_plan_run (struct ModesetPlan *plan);
+void modeset_plan_print (struct ModesetPlan *plan, FILE *file);
+void modeset_plan_print_errors (struct ModesetPlan *plan, FILE *file);
+void modeset_plan_free (struct ModesetPlan *plan);
+
+#endif
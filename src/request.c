@@ -0,0 +1,531 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * The --output request syntax of grandr-cli, shared with the resident
+ * daemon and with the GUI when it hands a layout over to the daemon.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "request.h"
+#include "layout.h"
+#include "assign.h"
+#include "validate.h"
+#include "clone.h"
+
+static const char *
+connection_name (Connection connection)
+{
+	switch (connection) {
+		case RR_Connected:
+			return "connected";
+		case RR_Disconnected:
+			return "disconnected";
+		default:
+			return "unknown connection";
+	}
+}
+
+void
+print_screen_info (struct ScreenInfo *screen_info, FILE *out)
+{
+	int i, j;
+	
+	fprintf (out, "Screen: current %d x %d, minimum %d x %d, maximum %d x %d\n",
+			  screen_info->cur_width, screen_info->cur_height,
+			  screen_info->min_width, screen_info->min_height,
+			  screen_info->max_width, screen_info->max_height);
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct OutputInfo *output = &screen_info->outputs[i];
+		struct CrtcInfo *crtc_info = output->cur_crtc;
+		XRROutputInfo *info = output->info;
+		XRRModeInfo *mode_info;
+		
+		fprintf (out, "%s %s", info->name, connection_name (info->connection));
+		if (crtc_info && (mode_info = find_mode_by_xid (screen_info, crtc_info->cur_mode_id))) {
+			fprintf (out, " %dx%d+%d+%d", 
+					  mode_width (mode_info, crtc_info->cur_rotation),
+					  mode_height (mode_info, crtc_info->cur_rotation),
+					  crtc_info->cur_x, crtc_info->cur_y);
+		}
+		fprintf (out, " (%lumm x %lumm)\n", info->mm_width, info->mm_height);
+		
+		for (j = 0; j < output->n_mode; j++) {
+			struct ModeEntry *entry = &screen_info->mode_db.entries[output->modes[j]];
+			
+			fprintf (out, "   %-12s %6.1f%s%s\n", entry->info->name, entry->refresh,
+					  crtc_info && crtc_info->cur_mode_id == entry->id ? "*" : " ",
+					  j == output->preferred ? "+" : "");
+		}
+	}
+}
+
+static struct OutputInfo *
+find_output_by_name (struct ScreenInfo *screen_info, const char *name)
+{
+	int i;
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		if (strcmp (screen_info->outputs[i].info->name, name) == 0) {
+			return &screen_info->outputs[i];
+		}
+	}
+	
+	return NULL;
+}
+
+/* the output mode called name, closest to rate when one is given */
+static XRRModeInfo *
+find_output_mode (struct ScreenInfo *screen_info, struct OutputInfo *output, 
+						const char *name, double rate)
+{
+	struct ModeEntry *best = NULL;
+	double best_dist = 0;
+	int i;
+	
+	/* all of info->modes, a duplicate may be the one with that name */
+	for (i = 0; i < output->info->nmode; i++) {
+		struct ModeEntry *entry = find_mode_entry (screen_info, output->info->modes[i]);
+		double dist;
+		
+		if (!entry || strcmp (entry->info->name, name) != 0) {
+			continue;
+		}
+		
+		dist = rate > 0 ? entry->refresh - rate : 0;
+		if (dist < 0) {
+			dist = -dist;
+		}
+		if (!best || dist < best_dist) {
+			best = entry;
+			best_dist = dist;
+		}
+	}
+	
+	return best ? best->info : NULL;
+}
+
+static int
+parse_rotation (const char *name, Rotation *rotation)
+{
+	if (strcmp (name, "normal") == 0) {
+		*rotation = RR_Rotate_0;
+	} else if (strcmp (name, "left") == 0) {
+		*rotation = RR_Rotate_90;
+	} else if (strcmp (name, "inverted") == 0) {
+		*rotation = RR_Rotate_180;
+	} else if (strcmp (name, "right") == 0) {
+		*rotation = RR_Rotate_270;
+	} else {
+		return 0;
+	}
+	
+	return 1;
+}
+
+static int
+parse_relation (const char *option)
+{
+	if (strcmp (option, "--left-of") == 0) {
+		return LAYOUT_LEFT_OF;
+	} else if (strcmp (option, "--right-of") == 0) {
+		return LAYOUT_RIGHT_OF;
+	} else if (strcmp (option, "--above") == 0) {
+		return LAYOUT_ABOVE;
+	} else if (strcmp (option, "--below") == 0) {
+		return LAYOUT_BELOW;
+	} else if (strcmp (option, "--same-as") == 0) {
+		return LAYOUT_SAME_AS;
+	}
+	
+	return -1;
+}
+
+/*
+ * Feed the relative placements, and the --pos of everything else, to the
+ * layout solver. Nothing to do unless some output asked to be placed
+ * relative to another one.
+ */
+static int
+solve_output_relations (struct ScreenInfo *screen_info, 
+								struct OutputRequest *reqs, int n_req, FILE *err)
+{
+	struct Layout layout;
+	int has_relation = 0;
+	int ok = 1;
+	int i;
+	
+	for (i = 0; i < n_req; i++) {
+		if (reqs[i].relation >= 0) {
+			has_relation = 1;
+		}
+	}
+	if (!has_relation) {
+		return 1;
+	}
+	
+	layout_init (&layout, screen_info);
+	for (i = 0; i < n_req && ok; i++) {
+		struct OutputRequest *req = &reqs[i];
+		struct OutputInfo *output, *anchor;
+		
+		output = find_output_by_name (screen_info, req->name);
+		if (!output->cur_crtc) {
+			continue;
+		}
+		
+		if (req->relation >= 0) {
+			anchor = find_output_by_name (screen_info, req->relative_to);
+			if (!anchor || !anchor->cur_crtc) {
+				fprintf (err, "%s: no such output, or it is off\n", req->relative_to);
+				ok = 0;
+				break;
+			}
+			layout_add (&layout, req->relation, output->cur_crtc, anchor->cur_crtc, 0, 0);
+		} else if (req->set_pos) {
+			layout_add (&layout, LAYOUT_ABSOLUTE, output->cur_crtc, NULL, req->x, req->y);
+		}
+	}
+	
+	if (ok) {
+		ok = layout_solve (&layout, err);
+	}
+	layout_free (&layout);
+	
+	return ok;
+}
+
+/* turn one --output block into pending changes on screen_info, -1 as output_auto () */
+static int
+set_output (struct ScreenInfo *screen_info, struct OutputRequest *req, FILE *err)
+{
+	struct OutputInfo *output;
+	struct CrtcInfo *crtc_info;
+	
+	output = find_output_by_name (screen_info, req->name);
+	if (!output) {
+		fprintf (err, "%s: no such output\n", req->name);
+		return 0;
+	}
+	
+	if (req->set_off) {
+		output_off (screen_info, output);
+		return 1;
+	}
+	
+	if (req->clone) {
+		/* clone_outputs () already picked the mode, honouring --mode-id */
+	} else if (req->set_auto) {
+		if (output_auto (screen_info, output) < 0) {
+			return -1;
+		}
+	} else if (req->mode || req->mode_id) {
+		XRRModeInfo *mode_info;
+		
+		if (req->mode_id) {
+			mode_info = find_mode_by_xid (screen_info, req->mode_id);
+		} else {
+			mode_info = find_output_mode (screen_info, output, req->mode, req->rate);
+		}
+		if (!mode_info) {
+			fprintf (err, "%s: no such mode\n", req->name);
+			return 0;
+		}
+		if (!output_set_mode (screen_info, output, mode_info->id)) {
+			fprintf (err, "%s: no usable crtc\n", req->name);
+			return 0;
+		}
+	}
+	
+	crtc_info = output->cur_crtc;
+	if (!crtc_info) {
+		if (req->set_pos || req->rotation || req->relation >= 0) {
+			fprintf (err, "%s: output is off\n", req->name);
+			return 0;
+		}
+		return 1;
+	}
+	
+	if (req->set_pos) {
+		crtc_info->cur_x = req->x;
+		crtc_info->cur_y = req->y;
+	}
+	if (req->rotation) {
+		if ((crtc_info->rotations & req->rotation) != req->rotation) {
+			fprintf (err, "%s: rotation not supported\n", req->name);
+			return 0;
+		}
+		crtc_info->cur_rotation = req->rotation;
+	}
+	
+	return 1;
+}
+
+/*
+ * Parse --output blocks into reqs, which must have room for argc entries.
+ * The strings in reqs point into argv. Returns the number of requests,
+ * or -1 after complaining on err.
+ */
+int
+parse_output_requests (int argc, char **argv, struct OutputRequest *reqs, FILE *err)
+{
+	struct OutputRequest *req = NULL;
+	int n_req = 0;
+	int relation;
+	int i;
+	
+	for (i = 0; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+		
+		if (strcmp (arg, "--output") == 0 && val) {
+			req = &reqs[n_req++];
+			memset (req, 0, sizeof (struct OutputRequest));
+			req->name = val;
+			req->relation = -1;
+			i++;
+			continue;
+		}
+		
+		if (!req) {
+			fprintf (err, "%s: expected --output first\n", arg);
+			return -1;
+		}
+		
+		if (strcmp (arg, "--auto") == 0) {
+			req->set_auto = 1;
+		} else if (strcmp (arg, "--off") == 0) {
+			req->set_off = 1;
+		} else if (strcmp (arg, "--clone") == 0) {
+			req->clone = 1;
+			/* an optional group name, so that several clone groups fit on one line */
+			if (val && strncmp (val, "--", 2) != 0) {
+				req->clone_group = val;
+				i++;
+			}
+		} else if (strcmp (arg, "--mode") == 0 && val) {
+			req->mode = val;
+			i++;
+		} else if (strcmp (arg, "--mode-id") == 0 && val) {
+			req->mode_id = strtoul (val, NULL, 0);
+			i++;
+		} else if (strcmp (arg, "--rate") == 0 && val) {
+			req->rate = atof (val);
+			i++;
+		} else if (strcmp (arg, "--pos") == 0 && val) {
+			if (sscanf (val, "%dx%d", &req->x, &req->y) != 2) {
+				fprintf (err, "%s: bad position\n", val);
+				return -1;
+			}
+			req->set_pos = 1;
+			i++;
+		} else if ((relation = parse_relation (arg)) >= 0 && val) {
+			req->relation = relation;
+			req->relative_to = val;
+			i++;
+		} else if (strcmp (arg, "--rotate") == 0 && val) {
+			if (!parse_rotation (val, &req->rotation)) {
+				fprintf (err, "%s: bad rotation\n", val);
+				return -1;
+			}
+			i++;
+		} else {
+			fprintf (err, "%s: unknown option\n", arg);
+			return -1;
+		}
+	}
+	
+	return n_req;
+}
+
+static int
+same_clone_group (struct OutputRequest *a, struct OutputRequest *b)
+{
+	if (!a->clone_group || !b->clone_group) {
+		return a->clone_group == b->clone_group;
+	}
+	
+	return strcmp (a->clone_group, b->clone_group) == 0;
+}
+
+/* set up the clone group of reqs[first], the first request in it */
+static int
+clone_group (struct ScreenInfo *screen_info, struct OutputRequest *reqs, int n_req, 
+				 int first, struct OutputInfo **clones, FILE *err)
+{
+	RRMode clone_mode_id = None;
+	int n_clone = 0;
+	int i;
+	
+	for (i = first; i < n_req; i++) {
+		if (!reqs[i].clone || !same_clone_group (&reqs[first], &reqs[i])) {
+			continue;
+		}
+		if (None == clone_mode_id) {
+			clone_mode_id = reqs[i].mode_id;
+		}
+		clones[n_clone] = find_output_by_name (screen_info, reqs[i].name);
+		if (!clones[n_clone]) {
+			fprintf (err, "%s: no such output\n", reqs[i].name);
+			return 0;
+		}
+		n_clone++;
+	}
+	
+	return clone_outputs (screen_info, clones, n_clone, clone_mode_id, err);
+}
+
+/*
+ * Set up every request and push the result to the server, 1 on success.
+ * Returns -1 with nothing sent if probing for --auto found modes the
+ * snapshot lacks; reread it and call again.
+ */
+int
+apply_output_requests (struct ScreenInfo *screen_info, 
+							  struct OutputRequest *reqs, int n_req, FILE *err)
+{
+	struct OutputInfo **clones;
+	int ok = 1;
+	int i, j;
+	
+	for (i = 0; i < n_req && ok; i++) {
+		if (!reqs[i].clone) {
+			ok = set_output (screen_info, &reqs[i], err);
+			if (ok < 0) {
+				return -1;
+			}
+		}
+	}
+	if (!ok) {
+		return 0;
+	}
+	
+	clones = malloc (sizeof (struct OutputInfo *) * (n_req + 1));
+	if (!clones) {
+		fprintf (err, "out of memory\n");
+		return 0;
+	}
+	
+	/* each clone group shares one picture, place and rotate it afterwards */
+	for (i = 0; i < n_req && ok; i++) {
+		if (!reqs[i].clone) {
+			continue;
+		}
+		for (j = 0; j < i; j++) {
+			if (reqs[j].clone && same_clone_group (&reqs[i], &reqs[j])) {
+				break;
+			}
+		}
+		if (j == i) {
+			ok = clone_group (screen_info, reqs, n_req, i, clones, err);
+		}
+	}
+	for (i = 0; i < n_req && ok; i++) {
+		if (reqs[i].clone) {
+			ok = set_output (screen_info, &reqs[i], err);
+		}
+	}
+	free (clones);
+	if (!ok) {
+		return 0;
+	}
+	
+	if (!solve_output_relations (screen_info, reqs, n_req, err)) {
+		return 0;
+	}
+	
+	if (validate_screen_info (screen_info, err)) {
+		return 0;
+	}
+	
+	if (!assign_crtcs (screen_info, err)) {
+		return 0;
+	}
+	
+	if (!set_screen_size (screen_info)) {
+		fprintf (err, "screen size larger than max screen size\n");
+		return 0;
+	}
+	
+	return apply_screen_info (screen_info);
+}
+
+static const char *
+rotation_name (Rotation rotation)
+{
+	switch (rotation & 0xf) {
+		case RR_Rotate_90:
+			return "left";
+		case RR_Rotate_180:
+			return "inverted";
+		case RR_Rotate_270:
+			return "right";
+		default:
+			return "normal";
+	}
+}
+
+/* 
+ * Describe the pending configuration of every output as --output blocks,
+ * the inverse of parse_output_requests (). The caller frees the string.
+ */
+char *
+format_output_requests (struct ScreenInfo *screen_info)
+{
+	char *buf;
+	size_t len;
+	FILE *file;
+	int i;
+	
+	file = open_memstream (&buf, &len);
+	if (!file) {
+		return NULL;
+	}
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct OutputInfo *output = &screen_info->outputs[i];
+		struct CrtcInfo *crtc_info = output->cur_crtc;
+		
+		if (!crtc_info || !crtc_info->cur_mode_id) {
+			fprintf (file, " --output %s --off", output->info->name);
+			continue;
+		}
+		
+		fprintf (file, " --output %s", output->info->name);
+		if (crtc_info->cur_noutput > 1) {
+			/* one group per crtc, named after its index */
+			fprintf (file, " --clone %d", (int) (crtc_info - screen_info->crtcs));
+		}
+		fprintf (file, " --mode-id 0x%lx --pos %dx%d --rotate %s",
+					crtc_info->cur_mode_id,
+					crtc_info->cur_x, crtc_info->cur_y,
+					rotation_name (crtc_info->cur_rotation));
+	}
+	
+	if (fclose (file) != 0) {
+		free (buf);
+		return NULL;
+	}
+	
+	return buf;
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_REQUEST_H
+#define RANDR_GUI_REQUEST_H
+
+#include <stdio.h>
+#include "screen.h"
+
+/* 
+ * One --output block of the command line syntax shared by grandr-cli,
+ * the resident daemon and the GUI talking to it.
+ */
+struct OutputRequest {
+	const char *name;
+	int set_auto;
+	int set_off;
+	int clone;			/* share one picture with the other --clone outputs */
+	const char *clone_group;	/* ... of this group, NULL for the unnamed one */
+	const char *mode;
+	RRMode mode_id;		/* exact mode, overrides mode/rate */
+	double rate;			/* 0 for any */
+	int set_pos;
+	int x, y;
+	int relation;			/* LAYOUT_*, -1 for none */
+	const char *relative_to;	/* output the relation refers to */
+	Rotation rotation;		/* 0 to keep */
+};
+
+int parse_output_requests (int argc, char **argv, struct OutputRequest *reqs, FILE *err);
+int apply_output_requests (struct ScreenInfo *screen_info, 
+									struct OutputRequest *reqs, int n_req, FILE *err);
+void print_screen_info (struct ScreenInfo *screen_info, FILE *out);
+char *format_output_requests (struct ScreenInfo *screen_info);
+
+#endif
@@ -0,0 +1,1272 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "screen.h"
+#include "modeset.h"
+#include "assign.h"
+#include "bitset.h"
+#include "backend.h"
+#include "trace.h"
+#include "log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+static double
+get_time_ms (void)
+{
+	struct timeval tv;
+	
+	gettimeofday (&tv, NULL);
+	
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+struct OutputInfo *
+get_output_info_by_xid (struct ScreenInfo *screen_info, RROutput output_id)
+{
+	int i;
+	
+	i = xid_hash_lookup (&screen_info->output_hash, output_id);
+	if (i < 0) {
+		return NULL;
+	}
+	
+	return &screen_info->outputs[i];
+}
+
+struct CrtcInfo *
+get_crtc_info_by_xid (struct ScreenInfo *screen_info, RRCrtc crtc_id)
+{
+	int i;
+	
+	i = xid_hash_lookup (&screen_info->crtc_hash, crtc_id);
+	if (i < 0) {
+		return NULL;
+	}
+	
+	return &screen_info->crtcs[i];
+}
+
+char *
+get_output_name (struct ScreenInfo *screen_info, RROutput id)
+{
+	struct OutputInfo *output;
+	
+	output = get_output_info_by_xid (screen_info, id);
+	if (!output) {
+		return "Unknown";
+	}
+	
+	return output->info->name;
+}
+
+XRRModeInfo *
+find_mode_by_xid (struct ScreenInfo *screen_info, RRMode mode_id)
+{
+	int i;
+	
+	i = xid_hash_lookup (&screen_info->mode_hash, mode_id);
+	if (i < 0) {
+		return NULL;
+	}
+	
+	return &screen_info->res->modes[i];
+}
+
+struct ModeEntry *
+find_mode_entry (struct ScreenInfo *screen_info, RRMode mode_id)
+{
+	int i;
+	
+	i = xid_hash_lookup (&screen_info->mode_hash, mode_id);
+	if (i < 0) {
+		return NULL;
+	}
+	
+	return &screen_info->mode_db.entries[i];
+}
+
+int
+mode_height (XRRModeInfo *mode_info, Rotation rotation)
+{
+    switch (rotation & 0xf) {
+    case RR_Rotate_0:
+    case RR_Rotate_180:
+        return mode_info->height;
+    case RR_Rotate_90:
+    case RR_Rotate_270:
+        return mode_info->width;
+    default:
+        return 0;
+    }
+}
+
+int
+mode_width (XRRModeInfo *mode_info, Rotation rotation)
+{
+    switch (rotation & 0xf) {
+    case RR_Rotate_0:
+    case RR_Rotate_180:
+        return mode_info->width;
+    case RR_Rotate_90:
+    case RR_Rotate_270:
+        return mode_info->height;
+    default:
+        return 0;
+    }
+}
+
+int
+get_width_by_output_id (struct ScreenInfo *screen_info, RROutput output_id)
+{
+	struct OutputInfo *output_info;
+	struct CrtcInfo *crtc_info;
+	XRRModeInfo *mode_info;
+	
+	output_info = get_output_info_by_xid (screen_info, output_id);
+	if (!output_info) {
+		return -1;
+	}
+	
+	crtc_info = output_info->cur_crtc;
+	if (!crtc_info) {
+		return 0;
+	}
+	mode_info = find_mode_by_xid (screen_info, crtc_info->cur_mode_id);
+	if (!mode_info) {
+		return 0;
+	}
+	
+	return mode_width (mode_info, crtc_info->cur_rotation);
+}
+
+int
+get_height_by_output_id (struct ScreenInfo *screen_info, RROutput output_id)
+{
+	struct OutputInfo *output_info;
+	struct CrtcInfo *crtc_info;
+	XRRModeInfo *mode_info;
+	
+	output_info = get_output_info_by_xid (screen_info, output_id);
+	if (!output_info) {
+		return -1;
+	}
+	
+	crtc_info = output_info->cur_crtc;
+	if (!crtc_info) {
+		return 0;
+	}
+	mode_info = find_mode_by_xid (screen_info, crtc_info->cur_mode_id);
+	if (!mode_info) {
+		return 0;
+	}
+	
+	return mode_height (mode_info, crtc_info->cur_rotation);
+}
+
+RRCrtc
+get_crtc_id_by_output_id (struct ScreenInfo *screen_info, RROutput output_id)
+{
+	struct OutputInfo *output_info;
+	
+	output_info = get_output_info_by_xid (screen_info, output_id);
+	if (!output_info) {
+		return -1;
+	}
+	
+	if (!output_info->cur_crtc) {
+		return 0;	//this output is off
+	}
+	
+	return output_info->cur_crtc->id;
+}
+
+static int
+compare_mode_id (const void *a, const void *b)
+{
+	RRMode ma = *(const RRMode *) a;
+	RRMode mb = *(const RRMode *) b;
+	
+	return (ma > mb) - (ma < mb);
+}
+
+/* 
+ * keep a sorted copy of the output's modes for set operations. Like the
+ * mode list and masks below it comes from the arena, a hotplug rebuilding
+ * them leaves the old copy there until the snapshot goes.
+ */
+static int
+output_build_mode_set (struct ScreenInfo *screen_info, struct OutputInfo *output)
+{
+	XRROutputInfo *info = output->info;
+	
+	output->n_mode_set = info->nmode;
+	output->mode_set = arena_alloc (&screen_info->arena, sizeof (RRMode) * (info->nmode + 1));
+	if (!output->mode_set) {
+		return 0;
+	}
+	memcpy (output->mode_set, info->modes, sizeof (RRMode) * info->nmode);
+	qsort (output->mode_set, output->n_mode_set, sizeof (RRMode), compare_mode_id);
+	
+	return 1;
+}
+
+/* the output's modes in the order the mode list shows them */
+static int
+output_build_mode_list (struct ScreenInfo *screen_info, struct OutputInfo *output)
+{
+	output->n_mode = mode_db_output_list (&screen_info->mode_db, &screen_info->mode_hash,
+													  output->info, &screen_info->arena,
+													  &output->modes, &output->preferred);
+	
+	return output->n_mode >= 0;
+}
+
+/* index info->modes, info->crtcs and info->clones, they are lists of XIDs */
+static int
+output_build_masks (struct ScreenInfo *screen_info, struct OutputInfo *output)
+{
+	XRROutputInfo *info = output->info;
+	int i, index;
+	
+	output->mode_mask = arena_alloc (&screen_info->arena, 
+												bitset_words (screen_info->res->nmode) * sizeof (unsigned long));
+	output->crtc_mask = arena_alloc (&screen_info->arena, 
+												bitset_words (screen_info->n_crtc) * sizeof (unsigned long));
+	output->clone_mask = arena_alloc (&screen_info->arena, 
+												 bitset_words (screen_info->n_output) * sizeof (unsigned long));
+	if (!output->mode_mask || !output->crtc_mask || !output->clone_mask) {
+		return 0;
+	}
+	
+	for (i = 0; i < info->nmode; i++) {
+		index = xid_hash_lookup (&screen_info->mode_hash, info->modes[i]);
+		if (index >= 0) {
+			bitset_set (output->mode_mask, index);
+		}
+	}
+	
+	for (i = 0; i < info->ncrtc; i++) {
+		index = xid_hash_lookup (&screen_info->crtc_hash, info->crtcs[i]);
+		if (index >= 0) {
+			bitset_set (output->crtc_mask, index);
+		}
+	}
+	
+	index = xid_hash_lookup (&screen_info->output_hash, output->id);
+	if (index >= 0) {
+		bitset_set (output->clone_mask, index);
+	}
+	for (i = 0; i < info->nclone; i++) {
+		index = xid_hash_lookup (&screen_info->output_hash, info->clones[i]);
+		if (index >= 0) {
+			bitset_set (output->clone_mask, index);
+		}
+	}
+	
+	return 1;
+}
+
+/* 
+ * Everything derived from output->info, after it was set or replaced.
+ * Returns 0 if the arena ran out, the output is half built then and the
+ * snapshot has to go.
+ */
+static int
+output_build (struct ScreenInfo *screen_info, struct OutputInfo *output)
+{
+	return output_build_mode_set (screen_info, output) &&
+			 output_build_mode_list (screen_info, output) &&
+			 output_build_masks (screen_info, output);
+}
+
+/* 
+ * Intersect the mode sets of every other output driven by the same crtc
+ * as output, i.e. the modes output may switch to without dropping its
+ * clones. Returns the number of modes stored in *modes, or -1 (and NULL)
+ * when no other output shares the crtc.
+ */
+int
+sibling_mode_set (struct ScreenInfo *screen_info, struct OutputInfo *output, RRMode **modes)
+{
+	RRMode *set = NULL;
+	int n_set = -1;
+	int i;
+	
+	*modes = NULL;
+	if (!output->cur_crtc) {
+		return -1;
+	}
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct OutputInfo *sibling = &screen_info->outputs[i];
+		int a, b, n;
+		
+		if (sibling == output || sibling->cur_crtc != output->cur_crtc) {
+			continue;
+		}
+		
+		if (!set) {
+			set = malloc (sizeof (RRMode) * (sibling->n_mode_set ? sibling->n_mode_set : 1));
+			memcpy (set, sibling->mode_set, sizeof (RRMode) * sibling->n_mode_set);
+			n_set = sibling->n_mode_set;
+			continue;
+		}
+		
+		/* merge two sorted sets in place */
+		a = b = n = 0;
+		while (a < n_set && b < sibling->n_mode_set) {
+			if (set[a] < sibling->mode_set[b]) {
+				a++;
+			} else if (set[a] > sibling->mode_set[b]) {
+				b++;
+			} else {
+				set[n++] = set[a];
+				a++;
+				b++;
+			}
+		}
+		n_set = n;
+	}
+	
+	*modes = set;
+	
+	return n_set;
+}
+
+/*check if other outputs that connected to the same crtc support this mode*/
+int
+check_mode (RRMode *sibling_modes, int n_sibling_mode, RRMode mode_id)
+{
+	if (n_sibling_mode < 0) {
+		return 1;
+	}
+	
+	return NULL != bsearch (&mode_id, sibling_modes, n_sibling_mode, 
+									sizeof (RRMode), compare_mode_id);
+}
+
+/*
+ * The modes output can be switched to right now: its mode list, minus
+ * what a clone on the same crtc cannot show. entries gets room for
+ * output->n_mode; *active is the index of the current mode (matched by
+ * key, it may have been dropped as a duplicate) or -1. Returns the count.
+ */
+int
+output_mode_choices (struct ScreenInfo *screen_info, struct OutputInfo *output,
+							struct ModeEntry **entries, int *active)
+{
+	struct ModeEntry *cur_entry = NULL;
+	RRMode *sibling_modes;
+	int n_sibling_mode;
+	int n = 0;
+	int i;
+	
+	*active = -1;
+	n_sibling_mode = sibling_mode_set (screen_info, output, &sibling_modes);
+	if (output->cur_crtc) {
+		cur_entry = find_mode_entry (screen_info, output->cur_crtc->cur_mode_id);
+	}
+	
+	for (i = 0; i < output->n_mode; i++) {
+		struct ModeEntry *entry = &screen_info->mode_db.entries[output->modes[i]];
+		
+		if (!check_mode (sibling_modes, n_sibling_mode, entry->id)) {
+			continue;
+		}
+		if (cur_entry && cur_entry->key == entry->key) {
+			*active = n;
+		}
+		entries[n++] = entry;
+	}
+	
+	free (sibling_modes);
+	
+	return n;
+}
+
+/*
+ * A free crtc for output, preferably one that can drive it. If only crtcs
+ * it cannot use are free, one of them holds its place and assign_crtcs ()
+ * sorts the assignment out before applying. NULL when every crtc is busy.
+ */
+struct CrtcInfo *
+auto_find_crtc (struct ScreenInfo *screen_info, struct OutputInfo *output_info)
+{
+	struct CrtcInfo *crtc_info = NULL;
+	int i;
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		if (0 != screen_info->crtcs[i].cur_noutput) {
+			continue;
+		}
+		if (bitset_test (output_info->crtc_mask, i)) {
+			return &screen_info->crtcs[i];
+		}
+		if (!crtc_info) {
+			crtc_info = &screen_info->crtcs[i];
+		}
+	}
+	
+	return crtc_info;
+}
+
+int
+set_screen_size (struct ScreenInfo *screen_info)
+{
+	struct CrtcInfo *crtc;
+	XRRModeInfo *mode_info;
+	Window root;
+	int cur_x = 0, cur_y = 0;
+	int w = 0, h = 0;
+	int mmW, mmH;
+	int live_width, live_height, live_mmWidth, live_mmHeight;
+	int max_width = 0, max_height = 0;
+	int i;
+	
+	randr_backend->get_screen (screen_info->dpy, &root, &live_width, &live_height,
+										&live_mmWidth, &live_mmHeight);
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		crtc = &screen_info->crtcs[i];
+		if (!crtc->cur_mode_id) {
+			continue;
+		}
+		mode_info = find_mode_by_xid (screen_info, crtc->cur_mode_id);
+		if (!mode_info) {
+			/* the mode went away under us, e.g. by an event */
+			log_warn ("crtc 0x%lx: unknown mode 0x%lx", crtc->id, crtc->cur_mode_id);
+			return 0;
+		}
+		cur_x = crtc->cur_x;
+		cur_y = crtc->cur_y;
+		
+		w = mode_width (mode_info, crtc->cur_rotation);
+		h = mode_height (mode_info, crtc->cur_rotation);
+		
+		if (cur_x + w > max_width) {
+			max_width = cur_x + w;
+		}
+		if (cur_y + h > max_height) {
+			max_height = cur_y + h;
+		}
+	}
+	
+		if (max_width > screen_info->max_width) {
+			log_warn ("user set screen width %d, larger than max width %d", 
+						 max_width, screen_info->max_width);
+			return 0;
+		} else if (max_width < screen_info->min_width) {
+			screen_info->cur_width = screen_info->min_width;
+		} else {
+			screen_info->cur_width = max_width;
+		} 
+	
+		if (max_height > screen_info->max_height) {
+			log_warn ("user set screen height %d, larger than max height %d", 
+						 max_height, screen_info->max_height);
+			return 0;
+		} else if (max_height < screen_info->min_height) {
+			screen_info->cur_height = screen_info->min_height;
+		} else {
+			screen_info->cur_height = max_height;
+		}
+	
+	
+	//calculate mmWidth, mmHeight
+	if (screen_info->cur_width != live_width ||
+		 screen_info->cur_height != live_height) {
+		double dpi; 
+		
+		dpi = (25.4 * live_height) / live_mmHeight;
+		mmW = (25.4 * screen_info->cur_width) / dpi;
+		mmH = (25.4 * screen_info->cur_height) / dpi;
+	} else {
+		mmW = live_mmWidth;
+		mmH = live_mmHeight;
+	}
+
+	screen_info->cur_mmWidth = mmW;
+	screen_info->cur_mmHeight = mmH;
+	
+	return 1;
+}
+
+/*
+ * Push the pending configuration to the server. set_screen_size () must
+ * have succeeded first. Everything is worked out before grabbing the
+ * server: other clients are frozen while we hold it, so the grab only
+ * covers sending the precomputed requests. Returns 1 on success.
+ */
+int
+apply_screen_info (struct ScreenInfo *screen_info)
+{
+	struct ModesetPlan *plan;
+	double grab_start;
+	int ok;
+	
+	trace_begin ("apply_screen_info", 0);
+	trace_begin ("assign_crtcs", 0);
+	ok = assign_crtcs (screen_info, stderr);
+	trace_end ("assign_crtcs", 0);
+	if (!ok) {
+		trace_end ("apply_screen_info", 0);
+		return 0;
+	}
+	
+	/* diff against what the server has now, not what we read at startup */
+	refresh_crtc_info (screen_info);
+	
+	trace_begin ("modeset_plan_new", 0);
+	plan = modeset_plan_new (screen_info);
+	trace_end ("modeset_plan_new", 0);
+	if (!plan) {
+		log_error ("out of memory planning the modeset");
+		trace_end ("apply_screen_info", 0);
+		return 0;
+	}
+	if (log_enabled (LOG_LEVEL_DEBUG)) {
+		char *text;
+		size_t len;
+		FILE *file = open_memstream (&text, &len);
+		
+		if (file) {
+			modeset_plan_print (plan, file);
+			fclose (file);
+			log_text (LOG_LEVEL_DEBUG, text);
+			free (text);
+		}
+	}
+	
+	grab_start = get_time_ms ();
+	trace_begin ("server_grab", 0);
+	randr_backend->grab (screen_info->dpy);
+	ok = modeset_plan_run (plan);
+	randr_backend->ungrab (screen_info->dpy);
+	trace_end ("server_grab", 0);
+	
+	log_debug ("server grabbed for %.3f ms", get_time_ms () - grab_start);
+	if (!ok) {
+		modeset_plan_print_errors (plan, stderr);
+	}
+	
+	modeset_plan_free (plan);
+	
+	/* what we just programmed is the new live state */
+	refresh_crtc_info (screen_info);
+	trace_end ("apply_screen_info", 0);
+	
+	return ok;
+}
+
+/* 
+ * overwrite a crtc's live info with a newer reply for it. The output list
+ * always fits (see crtc_info_from_reply), so the snapshot does not grow.
+ */
+static void
+crtc_info_update (XRRCrtcInfo *info, const XRRCrtcInfo *fresh)
+{
+	RROutput *outputs = info->outputs;
+	RROutput *possible = info->possible;
+	int npossible = info->npossible;
+	
+	*info = *fresh;
+	info->outputs = outputs;
+	info->possible = possible;
+	info->npossible = npossible;
+	if (info->noutput > npossible) {
+		info->noutput = npossible;
+	}
+	memcpy (info->outputs, fresh->outputs, info->noutput * sizeof (RROutput));
+}
+
+/* replace the live state of every crtc with a fresh copy from the server */
+void
+refresh_crtc_info (struct ScreenInfo *screen_info)
+{
+	struct Arena scratch;
+	XRRCrtcInfo **crtc_infos;
+	int i;
+	
+	trace_begin ("refresh_crtc_info", 0);
+	arena_init (&scratch, screen_info->n_crtc * 
+					(sizeof (XRRCrtcInfo *) + sizeof (XRRCrtcInfo) + 
+					 4 * screen_info->n_output * sizeof (RROutput)));
+	crtc_infos = arena_alloc (&scratch, sizeof (XRRCrtcInfo *) * (screen_info->n_crtc + 1));
+	if (crtc_infos) {
+		randr_backend->get_infos (screen_info, &scratch, crtc_infos, NULL);
+	}
+	
+	for (i = 0; crtc_infos && i < screen_info->n_crtc; i++) {
+		if (crtc_infos[i] && screen_info->crtcs[i].info) {
+			crtc_info_update (screen_info->crtcs[i].info, crtc_infos[i]);
+		}
+	}
+	
+	arena_free (&scratch);
+	trace_end ("refresh_crtc_info", 0);
+}
+
+/* throw away pending changes, going back to the live state of the server */
+void
+revert_screen_info (struct ScreenInfo *screen_info)
+{
+	int i;
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		struct CrtcInfo *crtc_info = &screen_info->crtcs[i];
+		XRRCrtcInfo *info = crtc_info->info;
+		
+		crtc_info->cur_x = info->x;
+		crtc_info->cur_y = info->y;
+		crtc_info->cur_mode_id = info->mode;
+		crtc_info->cur_rotation = info->rotation;
+		crtc_info->cur_noutput = 0;
+		crtc_info->changed = 0;
+	}
+	
+	/* output change events keep info->crtc current, crtc noutput is not */
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct OutputInfo *output = &screen_info->outputs[i];
+		
+		output->cur_crtc = get_crtc_info_by_xid (screen_info, output->info->crtc);
+		if (output->cur_crtc) {
+			output->cur_crtc->cur_noutput++;
+		}
+		output->auto_set = 0;
+		output->off_set = (NULL == output->cur_crtc);
+	}
+	
+	screen_info->cur_crtc = screen_info->cur_output->cur_crtc;
+}
+
+/*
+ * Two tiers of screen resources: the current view is what the server
+ * already knows and is cheap, while a probe makes the server poll every
+ * connector (DDC/EDID reads included) and may stall it for seconds.
+ * Only probe when the user asked for it or an output is known to be stale.
+ */
+XRRScreenResources *
+get_screen_resources (Display *dpy, Window window, int probe, struct Arena *arena)
+{
+	XRRScreenResources *res;
+	double start;
+	
+	start = get_time_ms ();
+	trace_begin (probe ? "probe_resources" : "get_resources", 0);
+	res = randr_backend->get_resources (dpy, window, probe, arena);
+	trace_end (probe ? "probe_resources" : "get_resources", 0);
+	
+	log_debug ("screen resources (%s): %.3f ms", 
+				  probe ? "probe" : "current", get_time_ms () - start);
+	
+	return res;
+}
+
+/* 
+ * A generous guess at the arena a snapshot of sr needs, so that it is
+ * built in a single block.
+ */
+static size_t
+snapshot_size_hint (XRRScreenResources *sr)
+{
+	size_t per_mode, per_crtc, per_output, names = 0;
+	int i;
+	
+	per_mode = sizeof (XRRModeInfo) + sizeof (struct ModeEntry) + 64 + 
+				  2 * sizeof (int) + 4 * (sizeof (XID) + sizeof (int)) + 16;
+	per_crtc = 2 * sizeof (struct CrtcInfo) + sizeof (XRRCrtcInfo) + 
+				  3 * sr->noutput * sizeof (RROutput) + (sr->noutput + sr->ncrtc) / 4 + 64;
+	per_output = sizeof (struct OutputInfo) + sizeof (XRROutputInfo) + 256 +
+					 sr->ncrtc * sizeof (RRCrtc) + sr->noutput * sizeof (RROutput) +
+					 sr->nmode * (2 * sizeof (RRMode) + sizeof (int)) + 
+					 (sr->nmode + sr->ncrtc + sr->noutput) / 8 + 64;
+	
+	for (i = 0; i < sr->nmode; i++) {
+		names += sr->modes[i].nameLength + 16;
+	}
+	
+	return sizeof (struct ScreenInfo) + 1024 + names +
+			 sr->nmode * per_mode + sr->ncrtc * per_crtc + sr->noutput * per_output;
+}
+
+/* an empty snapshot with its own arena, the ScreenInfo at its start */
+static struct ScreenInfo *
+screen_info_alloc (size_t size_hint)
+{
+	struct ScreenInfo *screen_info;
+	struct Arena arena;
+	
+	arena_init (&arena, size_hint);
+	screen_info = arena_alloc (&arena, sizeof (struct ScreenInfo));
+	if (!screen_info) {
+		arena_free (&arena);
+		return NULL;
+	}
+	screen_info->arena = arena;
+	screen_info->map = NULL;
+	screen_info->map_size = 0;
+	
+	return screen_info;
+}
+
+/*
+ * Everything past fetching: index the replies and derive the crtc and
+ * output records from them. The replies are used in place, not copied.
+ * Returns 0 if the arena ran out.
+ */
+static int
+screen_info_build (struct ScreenInfo *screen_info, struct ScreenReplies *replies)
+{
+	XRRScreenResources *sr = replies->res;
+	int i;
+	
+	screen_info->window = replies->root;
+	screen_info->res = sr;
+	screen_info->event_base = -1;
+	screen_info->cur_width = replies->width;
+	screen_info->cur_height = replies->height;
+	screen_info->cur_mmWidth = replies->mm_width;
+	screen_info->cur_mmHeight = replies->mm_height;
+	screen_info->min_width = replies->min_width;
+	screen_info->min_height = replies->min_height;
+	screen_info->max_width = replies->max_width;
+	screen_info->max_height = replies->max_height;
+	screen_info->n_output = sr->noutput;
+	screen_info->n_crtc = sr->ncrtc;
+	screen_info->outputs = arena_alloc (&screen_info->arena, 
+													sizeof (struct OutputInfo) * (sr->noutput + 1));
+	screen_info->crtcs = arena_alloc (&screen_info->arena, 
+												 sizeof (struct CrtcInfo) * (sr->ncrtc + 1));
+	screen_info->saved_crtcs = arena_alloc (&screen_info->arena, 
+														 sizeof (struct CrtcInfo) * (sr->ncrtc + 1));
+	screen_info->clone = 0;
+	if (!screen_info->outputs || !screen_info->crtcs || !screen_info->saved_crtcs) {
+		return 0;
+	}
+	
+	//index modes, crtcs and outputs by XID
+	trace_begin ("index_snapshot", 0);
+	if (!xid_hash_init (&screen_info->mode_hash, sr->nmode, &screen_info->arena) ||
+		 !mode_db_init (&screen_info->mode_db, sr, &screen_info->arena) ||
+		 !xid_hash_init (&screen_info->crtc_hash, sr->ncrtc, &screen_info->arena) ||
+		 !xid_hash_init (&screen_info->output_hash, sr->noutput, &screen_info->arena)) {
+		trace_end ("index_snapshot", 0);
+		return 0;
+	}
+	for (i = 0; i < sr->nmode; i++) {
+		xid_hash_insert (&screen_info->mode_hash, sr->modes[i].id, i);
+	}
+	for (i = 0; i < sr->ncrtc; i++) {
+		xid_hash_insert (&screen_info->crtc_hash, sr->crtcs[i], i);
+	}
+	for (i = 0; i < sr->noutput; i++) {
+		xid_hash_insert (&screen_info->output_hash, sr->outputs[i], i);
+	}
+	trace_end ("index_snapshot", 0);
+	
+	//get crtc
+	trace_begin ("build_snapshot", 0);
+	for (i = 0; i < sr->ncrtc; i++) {
+		struct CrtcInfo *crtc_info = &screen_info->crtcs[i];
+		XRRCrtcInfo *xrr_crtc_info = replies->crtc_infos[i];
+		
+		crtc_info->id = sr->crtcs[i];
+		crtc_info->info = xrr_crtc_info;
+		crtc_info->cur_x = xrr_crtc_info->x;
+		crtc_info->cur_y = xrr_crtc_info->y;
+		crtc_info->cur_mode_id = xrr_crtc_info->mode;
+		crtc_info->cur_rotation = xrr_crtc_info->rotation;
+		crtc_info->rotations = xrr_crtc_info->rotations;
+		crtc_info->cur_noutput = xrr_crtc_info->noutput;
+	
+		crtc_info->changed = 0;
+		crtc_info->members = arena_alloc (&screen_info->arena, 
+													 bitset_words (sr->noutput) * sizeof (unsigned long));
+		crtc_info->allowed = arena_alloc (&screen_info->arena, 
+													 bitset_words (sr->noutput) * sizeof (unsigned long));
+		crtc_info->drivers = arena_alloc (&screen_info->arena, 
+													 bitset_words (sr->ncrtc) * sizeof (unsigned long));
+		crtc_info->screen_info = screen_info;
+		if (!crtc_info->members || !crtc_info->allowed || !crtc_info->drivers) {
+			trace_end ("build_snapshot", 0);
+			return 0;
+		}
+	}
+	
+	
+	//get output
+	for (i = 0; i < sr->noutput; i++) {
+		struct OutputInfo *output = &screen_info->outputs[i];
+		
+		output->id = sr->outputs[i];
+		output->info = replies->output_infos[i];
+		if (!output_build (screen_info, output)) {
+			trace_end ("build_snapshot", 0);
+			return 0;
+		}
+		output->cur_crtc = get_crtc_info_by_xid (screen_info, output->info->crtc);
+		output->auto_set = 0;
+		if (output->cur_crtc) {
+			output->off_set = 0;
+		} else {
+			output->off_set = 1;
+		}
+		
+	}
+	
+	//set current crtc
+	screen_info->cur_crtc = screen_info->outputs[0].cur_crtc;
+	screen_info->primary_crtc = screen_info->cur_crtc;
+	screen_info->cur_output = &screen_info->outputs[0];
+	
+	trace_end ("build_snapshot", 0);
+	
+	return 1;
+}
+
+/* every reply is there, none was lost to a failed request or allocation */
+static int
+replies_complete (struct ScreenReplies *replies)
+{
+	int i;
+	
+	if (!replies->crtc_infos || !replies->output_infos) {
+		return 0;
+	}
+	for (i = 0; i < replies->res->ncrtc; i++) {
+		if (!replies->crtc_infos[i]) {
+			return 0;
+		}
+	}
+	for (i = 0; i < replies->res->noutput; i++) {
+		if (!replies->output_infos[i]) {
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+/*
+ * A fresh snapshot from the server, NULL (after logging why) if a reply
+ * is missing or memory ran out.
+ */
+struct ScreenInfo*
+read_screen_info (Display *display, int probe)
+{
+	struct ScreenInfo *screen_info;
+	struct ScreenReplies replies;
+	struct Arena scratch;
+	XRRScreenResources *sr;
+	
+	trace_begin ("read_screen_info", 0);
+	randr_backend->get_screen (display, &replies.root, &replies.width, &replies.height,
+										&replies.mm_width, &replies.mm_height);
+	
+	arena_init (&scratch, 0);
+	sr = get_screen_resources (display, replies.root, probe, &scratch);
+	
+	/* the snapshot starts with itself, from then on use its own arena */
+	screen_info = sr ? screen_info_alloc (snapshot_size_hint (sr)) : NULL;
+	if (screen_info) {
+		sr = screen_resources_dup (&screen_info->arena, sr);
+	}
+	arena_free (&scratch);
+	if (!screen_info || !sr) {
+		log_error ("cannot read the screen resources");
+		free_screen_info (screen_info);
+		trace_end ("read_screen_info", 0);
+		return NULL;
+	}
+	
+	screen_info->dpy = display;
+	screen_info->window = replies.root;
+	screen_info->res = sr;
+	screen_info->round_trips = 1;
+	replies.res = sr;
+	
+	//get min max width height
+	randr_backend->get_size_range (display, replies.root, 
+					&replies.min_width, &replies.min_height,
+					&replies.max_width, &replies.max_height);
+	screen_info->round_trips++;
+	
+	replies.crtc_infos = arena_alloc (&screen_info->arena, 
+												 sizeof (XRRCrtcInfo *) * (sr->ncrtc + 1));
+	replies.output_infos = arena_alloc (&screen_info->arena, 
+													sizeof (XRROutputInfo *) * (sr->noutput + 1));
+	trace_begin ("get_infos", 0);
+	if (replies.crtc_infos && replies.output_infos) {
+		randr_backend->get_infos (screen_info, &screen_info->arena, 
+										  replies.crtc_infos, replies.output_infos);
+	}
+	trace_end ("get_infos", 0);
+	
+	if (!replies_complete (&replies)) {
+		log_error ("cannot read the crtc and output info");
+		free_screen_info (screen_info);
+		trace_end ("read_screen_info", 0);
+		return NULL;
+	}
+	
+	if (!screen_info_build (screen_info, &replies)) {
+		log_error ("out of memory building the screen info");
+		free_screen_info (screen_info);
+		trace_end ("read_screen_info", 0);
+		return NULL;
+	}
+	
+	log_debug ("read screen info: %d crtcs, %d outputs in %d round trips",
+				  sr->ncrtc, sr->noutput, screen_info->round_trips);
+	trace_end ("read_screen_info", 0);
+	
+	return screen_info;	
+}
+
+/*
+ * A snapshot of replies kept from an earlier run (see snapcache.c),
+ * without asking the server anything. map is the mapping the replies
+ * live in, it is unmapped with the snapshot. On NULL (out of memory)
+ * map is left to the caller.
+ */
+struct ScreenInfo *
+screen_info_from_replies (Display *display, struct ScreenReplies *replies, 
+								  void *map, size_t map_size)
+{
+	struct ScreenInfo *screen_info;
+	
+	screen_info = screen_info_alloc (snapshot_size_hint (replies->res));
+	if (!screen_info) {
+		return NULL;
+	}
+	screen_info->dpy = display;
+	screen_info->map = map;
+	screen_info->map_size = map_size;
+	if (!screen_info_build (screen_info, replies)) {
+		log_error ("out of memory building the cached screen info");
+		screen_info->map = NULL;
+		free_screen_info (screen_info);
+		return NULL;
+	}
+	
+	return screen_info;
+}
+
+/* ask the server to tell us about hotplug and configuration changes */
+void
+select_screen_events (struct ScreenInfo *screen_info)
+{
+	screen_info->event_base = randr_backend->select_events (screen_info->dpy, 
+																			  screen_info->window);
+}
+
+static void
+crtc_change_notify (struct ScreenInfo *screen_info, XRRCrtcChangeNotifyEvent *ev)
+{
+	struct CrtcInfo *crtc_info;
+	XRRCrtcInfo *live;
+	
+	crtc_info = get_crtc_info_by_xid (screen_info, ev->crtc);
+	if (!crtc_info) {
+		return;
+	}
+	live = crtc_info->info;
+	
+	/* follow the server unless the user has pending edits on this crtc */
+	if (!crtc_info->changed) {
+		crtc_info->cur_x = ev->x;
+		crtc_info->cur_y = ev->y;
+		crtc_info->cur_mode_id = ev->mode;
+		crtc_info->cur_rotation = ev->rotation;
+	}
+	
+	live->x = ev->x;
+	live->y = ev->y;
+	live->width = ev->width;
+	live->height = ev->height;
+	live->mode = ev->mode;
+	live->rotation = ev->rotation;
+}
+
+/* returns 0 when the output refers to modes this snapshot does not know, or memory ran out */
+static int
+output_change_notify (struct ScreenInfo *screen_info, struct OutputInfo *output,
+							 XRROutputChangeNotifyEvent *ev)
+{
+	XRROutputInfo *info;
+	struct CrtcInfo *old_crtc, *new_crtc;
+	int following;
+	int i;
+	
+	old_crtc = get_crtc_info_by_xid (screen_info, output->info->crtc);
+	new_crtc = get_crtc_info_by_xid (screen_info, ev->crtc);
+	following = (output->cur_crtc == old_crtc);
+	
+	if (ev->connection != output->info->connection) {
+		/* plugged or unplugged: the mode list changes too, refetch this output only */
+		/* the old reply stays in the arena, hotplugs are rare enough */
+		info = randr_backend->get_output_info (screen_info->dpy, screen_info->res, 
+															output->id, &screen_info->arena);
+		if (!info) {
+			return 0;
+		}
+		for (i = 0; i < info->nmode; i++) {
+			if (!find_mode_by_xid (screen_info, info->modes[i])) {
+				return 0;
+			}
+		}
+		output->info = info;
+		if (!output_build (screen_info, output)) {
+			return 0;
+		}
+	}
+	output->info->crtc = ev->crtc;
+	output->info->connection = ev->connection;
+	
+	if (following && output->cur_crtc != new_crtc) {
+		if (output->cur_crtc) {
+			output->cur_crtc->cur_noutput--;
+		}
+		if (new_crtc) {
+			new_crtc->cur_noutput++;
+		}
+		output->cur_crtc = new_crtc;
+		output->off_set = (NULL == new_crtc);
+	}
+	
+	return 1;
+}
+
+/*
+ * Fold a RandR event into the snapshot, touching only the crtc or output
+ * it is about. Returns a mask of SCREEN_EVENT_* flags saying what changed
+ * (0 for events that are not ours). SCREEN_EVENT_STALE means the event
+ * cannot be applied incrementally and the snapshot should be read again.
+ * *changed_output is set for SCREEN_EVENT_OUTPUT.
+ */
+int
+screen_info_handle_event (struct ScreenInfo *screen_info, XEvent *event, 
+								  struct OutputInfo **changed_output)
+{
+	int event_base = screen_info->event_base;
+	
+	*changed_output = NULL;
+	if (event_base < 0) {
+		return 0;
+	}
+	
+	if (event->type == event_base + RRScreenChangeNotify) {
+		XRRScreenChangeNotifyEvent *ev = (XRRScreenChangeNotifyEvent *) event;
+		
+		XRRUpdateConfiguration (event);
+		if (ev->config_timestamp != screen_info->res->configTimestamp) {
+			return SCREEN_EVENT_STALE;
+		}
+		return SCREEN_EVENT_SIZE;
+	}
+	
+	if (event->type != event_base + RRNotify) {
+		return 0;
+	}
+	
+	switch (((XRRNotifyEvent *) event)->subtype) {
+		case RRNotify_CrtcChange:
+			crtc_change_notify (screen_info, (XRRCrtcChangeNotifyEvent *) event);
+			return SCREEN_EVENT_CRTC;
+		case RRNotify_OutputChange: {
+			XRROutputChangeNotifyEvent *ev = (XRROutputChangeNotifyEvent *) event;
+			struct OutputInfo *output;
+			
+			output = get_output_info_by_xid (screen_info, ev->output);
+			if (!output || !output_change_notify (screen_info, output, ev)) {
+				return SCREEN_EVENT_STALE;
+			}
+			*changed_output = output;
+			return SCREEN_EVENT_OUTPUT;
+		}
+		default:
+			return 0;
+	}
+}
+
+/* 
+ * Release the snapshot and everything it owns: the screen resources, the
+ * live crtc and output info replies, the per crtc and per output records
+ * and the indexes built over them all live in its arena.
+ */
+void 
+free_screen_info (struct ScreenInfo *screen_info)
+{
+	struct Arena arena;
+	
+	if (!screen_info) {
+		return;
+	}
+	arena = screen_info->arena;
+	if (screen_info->map) {
+		munmap (screen_info->map, screen_info->map_size);
+	}
+	arena_free (&arena);
+}
+
+/* 
+ * The output's preferred mode, or failing that the one closest to the
+ * current screen DPI (the heuristic of xrandr --auto).
+ */
+static XRRModeInfo *
+preferred_mode (struct ScreenInfo *screen_info, struct OutputInfo *output)
+{
+	XRROutputInfo *output_info = output->info;
+	struct ModeEntry *best = NULL;
+	Window root;
+	int width, height, mm_width, mm_height;
+	int best_dist = 0;
+	int m;
+	
+	if (output->preferred >= 0) {
+		return screen_info->mode_db.entries[output->modes[output->preferred]].info;
+	}
+	
+	randr_backend->get_screen (screen_info->dpy, &root, &width, &height, &mm_width, &mm_height);
+	
+	for (m = 0; m < output->n_mode; m++) {
+		struct ModeEntry *entry = &screen_info->mode_db.entries[output->modes[m]];
+		int dist;
+		
+		if (output_info->mm_height) {
+			dist = (1000 * height / mm_height -
+					  1000 * entry->height / output_info->mm_height);
+		} else {
+			dist = height - entry->height;
+		}
+		
+		if (dist < 0) {
+			dist = -dist;
+		}
+		if (!best || dist < best_dist) {
+			best = entry;
+			best_dist = dist;
+		}
+	}
+	
+	return best ? best->info : NULL;
+}
+
+/* 
+ * Drive output with mode_id, picking a free crtc for it if it is off.
+ * Returns 0 when no crtc is available.
+ */
+int
+output_set_mode (struct ScreenInfo *screen_info, struct OutputInfo *output_info, RRMode mode_id)
+{
+	struct CrtcInfo *crtc_info;
+	
+	crtc_info = output_info->cur_crtc;
+	if (!crtc_info) {
+		crtc_info = auto_find_crtc (screen_info, output_info);
+		if (!crtc_info) {
+			log_warn ("%s: can not find usable CRTC", output_info->info->name);
+			return 0;
+		}
+		output_info->cur_crtc = crtc_info;
+		crtc_info->cur_noutput++;
+		if (output_info == screen_info->cur_output) {
+			screen_info->cur_crtc = crtc_info;
+		}
+	}
+	
+	crtc_info->cur_mode_id = mode_id;
+	crtc_info->changed = 1;
+	output_info->off_set = 0;
+	
+	return 1;
+}
+
+/*
+ * Switch output on at its preferred mode, reprobing first if the server
+ * thinks it is disconnected. Returns 1 if it got a mode and 0 if not.
+ * Returns -1 if the probe turned up modes the snapshot does not hold, a
+ * monitor just plugged in: the caller rereads the snapshot (the server
+ * has probed by now) and calls again. The same goes when rebuilding the
+ * output ran out of memory.
+ */
+int 
+output_auto (struct ScreenInfo *screen_info, struct OutputInfo *output_info)
+{
+	XRRModeInfo *mode_info;
+	XRROutputInfo *probe_output_info;
+	int i;
+	
+	if (RR_Disconnected == output_info->info->connection) {
+		XRRScreenResources *cur_res;
+		struct Arena scratch;
+		
+		/* the user asked for an output the server believes is gone: reprobe */
+		arena_init (&scratch, 0);
+		cur_res = get_screen_resources (screen_info->dpy, screen_info->window, 1, &scratch);
+		probe_output_info = NULL;
+		if (cur_res) {
+			probe_output_info = randr_backend->get_output_info (screen_info->dpy, cur_res, 
+																				 output_info->id, 
+																				 &screen_info->arena);
+		}
+		arena_free (&scratch);
+		if (probe_output_info && RR_Disconnected != probe_output_info->connection) {
+			for (i = 0; i < probe_output_info->nmode; i++) {
+				if (xid_hash_lookup (&screen_info->mode_hash, probe_output_info->modes[i]) < 0) {
+					log_info ("%s: probe found new modes, snapshot is stale", 
+								 output_info->info->name);
+					return -1;
+				}
+			}
+			output_info->info = probe_output_info;
+			if (!output_build (screen_info, output_info)) {
+				/* a fresh snapshot is the only way back */
+				log_error ("%s: out of memory rebuilding the output", output_info->info->name);
+				return -1;
+			}
+		}
+	}
+	
+	mode_info = preferred_mode (screen_info, output_info);
+	if (!mode_info) {
+		return 0;
+	}
+	
+	return output_set_mode (screen_info, output_info, mode_info->id);
+}
+
+void 
+output_off (struct ScreenInfo *screen_info, struct OutputInfo *output)
+{
+	if (output->cur_crtc) {
+		output->cur_crtc->cur_noutput--;
+	}
+	output->cur_crtc = NULL;
+	if (output == screen_info->cur_output) {
+		screen_info->cur_crtc = NULL;
+	}
+	output->off_set = 1;
+}
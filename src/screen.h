@@ -0,0 +1,173 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_SCREEN_H
+#define RANDR_GUI_SCREEN_H
+
+/*
+ * RandR state and the operations on it. Nothing in here depends on GTK,
+ * so it is shared by the GUI and the command line tool.
+ */
+
+#include <X11/Xlib.h>
+#include <X11/extensions/Xrandr.h>
+
+#include "constant.h"
+#include "arena.h"
+#include "xidhash.h"
+#include "modedb.h"
+
+struct ScreenInfo;
+
+/*
+ * A ScreenInfo owns everything reachable from it: res, the info replies
+ * of its crtcs and outputs, the CrtcInfo/OutputInfo records and their
+ * masks and mode lists. All of it, the ScreenInfo included, is carved
+ * out of the snapshot's arena, so free_screen_info () is one arena_free ().
+ * A snapshot loaded from the startup cache leaves the replies in the
+ * cache file's mapping instead, which goes with it.
+ * The crtc and output records are stored by value, in res order.
+ */
+struct CrtcInfo {
+	RRCrtc id;
+	XRRCrtcInfo *info;
+	int cur_x;
+	int cur_y;
+	RRMode cur_mode_id;
+	Rotation cur_rotation;
+	Rotation rotations;
+	int cur_noutput;
+	
+	int changed;
+	
+	/* 
+	 * Scratch for validate_screen_info () and assign.c: bitsets of
+	 * outputs (by index), of crtcs (by index) and the crtc matching.
+	 */
+	unsigned long *members;
+	unsigned long *allowed;
+	unsigned long *drivers;
+	int match, owner, visited;
+	
+	struct ScreenInfo *screen_info;
+};
+
+struct OutputInfo {
+	RROutput id;
+	XRROutputInfo *info;
+	struct CrtcInfo *cur_crtc;
+	
+	RRMode *mode_set;		/* info->modes, sorted by id */
+	int n_mode_set;
+	
+	int *modes;			/* mode_db entries in display order, no duplicates */
+	int n_mode;
+	int preferred;			/* index into modes, -1 for none */
+	
+	unsigned long *mode_mask;	/* bitset of the modes (by index into res->modes) it has */
+	unsigned long *crtc_mask;	/* bitset of the crtcs (by index) info->crtcs allows */
+	unsigned long *clone_mask;	/* bitset of the outputs it can clone, itself included */
+	
+	int auto_set;
+	int off_set;
+};
+
+struct ScreenInfo {
+	struct Arena arena;		/* backs the snapshot, this struct included */
+	void *map;				/* the cache image res and the infos point into, or NULL */
+	size_t map_size;
+	Display *dpy;
+	Window window;
+	XRRScreenResources *res;
+	int round_trips;		/* X round trips spent reading this snapshot */
+	int event_base;		/* RandR event base, -1 until events are selected */
+	int min_width, min_height;
+	int max_width, max_height;
+	int cur_width;
+	int cur_height;
+	int cur_mmWidth;
+	int cur_mmHeight;
+	
+  	int n_output;
+  	int n_crtc;
+  	struct OutputInfo *outputs;
+  	struct CrtcInfo *crtcs;
+  	struct CrtcInfo *saved_crtcs;	/* scratch for assign_crtcs () and clone_outputs () */
+  	
+  	/* XID -> index into res->modes, outputs and crtcs */
+  	struct XidHash mode_hash;
+  	struct XidHash output_hash;
+  	struct XidHash crtc_hash;
+  	
+  	struct ModeDb mode_db;
+  	
+  	int clone;
+  	struct CrtcInfo *primary_crtc;
+  	
+  	struct CrtcInfo *cur_crtc;
+  	struct OutputInfo *cur_output;
+};
+
+/* what a snapshot is built from, as it came from the server */
+struct ScreenReplies {
+	Window root;
+	int width, height, mm_width, mm_height;
+	int min_width, min_height, max_width, max_height;
+	XRRScreenResources *res;
+	XRRCrtcInfo **crtc_infos;		/* in res->crtcs order */
+	XRROutputInfo **output_infos;	/* in res->outputs order */
+};
+
+struct ScreenInfo* read_screen_info (Display *, int probe);
+struct ScreenInfo *screen_info_from_replies (Display *display, struct ScreenReplies *replies, 
+														  void *map, size_t map_size);
+void free_screen_info (struct ScreenInfo *screen_info);
+XRRScreenResources *get_screen_resources (Display *dpy, Window window, int probe, 
+												  struct Arena *arena);
+void refresh_crtc_info (struct ScreenInfo *screen_info);
+void revert_screen_info (struct ScreenInfo *screen_info);
+
+void select_screen_events (struct ScreenInfo *screen_info);
+int screen_info_handle_event (struct ScreenInfo *screen_info, XEvent *event, 
+									   struct OutputInfo **changed_output);
+
+int set_screen_size (struct ScreenInfo *screen_info);
+int apply_screen_info (struct ScreenInfo *screen_info);
+int output_set_mode (struct ScreenInfo *screen_info, struct OutputInfo *output_info, RRMode mode_id);
+int output_auto (struct ScreenInfo *screen_info, struct OutputInfo *output_info);
+void output_off (struct ScreenInfo *screen_info, struct OutputInfo *output);
+struct CrtcInfo* auto_find_crtc (struct ScreenInfo *screen_info, struct OutputInfo *output_info);
+
+XRRModeInfo *find_mode_by_xid (struct ScreenInfo *screen_info, RRMode mode_id);
+struct ModeEntry *find_mode_entry (struct ScreenInfo *screen_info, RRMode mode_id);
+struct OutputInfo *get_output_info_by_xid (struct ScreenInfo *screen_info, RROutput output_id);
+struct CrtcInfo *get_crtc_info_by_xid (struct ScreenInfo *screen_info, RRCrtc crtc_id);
+RRCrtc get_crtc_id_by_output_id (struct ScreenInfo *screen_info, RROutput output_id);
+int mode_height (XRRModeInfo *mode_info, Rotation rotation);
+int mode_width (XRRModeInfo *mode_info, Rotation rotation);
+int get_width_by_output_id (struct ScreenInfo *screen_info, RROutput output_id);
+int get_height_by_output_id (struct ScreenInfo *screen_info, RROutput output_id);
+char *get_output_name (struct ScreenInfo *screen_info, RROutput id);
+int sibling_mode_set (struct ScreenInfo *screen_info, struct OutputInfo *output, RRMode **modes);
+int check_mode (RRMode *sibling_modes, int n_sibling_mode, RRMode mode_id);
+int output_mode_choices (struct ScreenInfo *screen_info, struct OutputInfo *output,
+							 struct ModeEntry **entries, int *active);
+#endif
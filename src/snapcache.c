@@ -0,0 +1,588 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * The startup cache: the replies behind the last snapshot read from the
+ * server, in $XDG_CACHE_HOME/grandr/<display>.snapshot. The file is the
+ * Xlib structures as they sit in memory, with every pointer stored as an
+ * offset into the file. Loading maps it privately and turns the offsets
+ * back into pointers in place, then builds the snapshot around it
+ * without a single round trip. It is only valid on the machine and build
+ * that wrote it, which the header checks.
+ *
+ * Only the replies are kept. The indexes derived from them (the xid
+ * hashes, mode_db and the per output masks) are built of pointers into
+ * the snapshot's arena and take far less time to rebuild than the round
+ * trips the cache saves, so screen_info_from_replies () rebuilds them.
+ *
+ * The cache is skipped without a home to put it in, and a file or
+ * directory someone else could have written is never trusted.
+ *
+ * Whether the server still agrees is snapshot_cache_confirm ()'s job,
+ * one round trip the GUI makes after it is on screen.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapcache.h"
+#include "backend.h"
+#include "trace.h"
+#include "log.h"
+
+#define CACHE_MAGIC		"grandrSC"
+#define CACHE_VERSION	1
+
+struct CacheHeader {
+	char magic[8];
+	unsigned int version;
+	unsigned short sizes[6];	/* catches another ABI or build */
+	unsigned long size;			/* of the whole file */
+	Window root;
+	int min_width, min_height, max_width, max_height;
+	unsigned long res;			/* offset of the XRRScreenResources */
+	unsigned long crtc_infos;	/* offset of res->ncrtc XRRCrtcInfo offsets */
+	unsigned long output_infos;	/* offset of res->noutput XRROutputInfo offsets */
+};
+
+/* the file being put together in memory */
+struct CacheImage {
+	char *buf;
+	size_t len;
+	size_t size;
+	int out_of_memory;		/* the image is incomplete, do not write it */
+};
+
+#define IMAGE_OFFSET(offset)	((void *) (uintptr_t) (offset))
+
+static void
+cache_sizes (unsigned short *sizes)
+{
+	sizes[0] = sizeof (void *);
+	sizes[1] = sizeof (struct CacheHeader);
+	sizes[2] = sizeof (XRRScreenResources);
+	sizes[3] = sizeof (XRRModeInfo);
+	sizes[4] = sizeof (XRRCrtcInfo);
+	sizes[5] = sizeof (XRROutputInfo);
+}
+
+/* $XDG_CACHE_HOME/grandr/<display>.snapshot, or ~/.cache/...; NULL without either */
+static char *
+cache_path (Display *display)
+{
+	const char *cache_home = getenv ("XDG_CACHE_HOME");
+	const char *home = getenv ("HOME");
+	const char *display_name = DisplayString (display);
+	char *path, *p;
+	size_t size;
+	
+	if (cache_home && *cache_home) {
+		size = strlen (cache_home) + strlen (display_name) + 32;
+		path = malloc (size);
+		if (!path) {
+			return NULL;
+		}
+		snprintf (path, size, "%s/grandr", cache_home);
+	} else if (home && *home) {
+		size = strlen (home) + strlen (display_name) + 40;
+		path = malloc (size);
+		if (!path) {
+			return NULL;
+		}
+		snprintf (path, size, "%s/.cache/grandr", home);
+	} else {
+		return NULL;
+	}
+	
+	p = path + strlen (path);
+	snprintf (p, size - (p - path), "/%s.snapshot", display_name);
+	for (p++; *p; p++) {
+		if (*p == '/') {
+			*p = '_';
+		}
+	}
+	
+	return path;
+}
+
+/* ours and writable by nobody else, so nobody else can have planted it */
+static int
+cache_trusted (struct stat *st)
+{
+	return st->st_uid == getuid () && !(st->st_mode & (S_IWGRP | S_IWOTH));
+}
+
+/* whether the directory holding path can be trusted, creating it first if asked to */
+static int
+cache_dir_ready (const char *path, int create)
+{
+	struct stat st;
+	char *dir, *slash;
+	int ok;
+	
+	dir = strdup (path);
+	if (!dir) {
+		return 0;
+	}
+	*strrchr (dir, '/') = '\0';
+	if (create) {
+		slash = strrchr (dir, '/');
+		*slash = '\0';
+		mkdir (dir, 0700);
+		*slash = '/';
+		mkdir (dir, 0700);
+	}
+	ok = stat (dir, &st) == 0 && S_ISDIR (st.st_mode) && cache_trusted (&st);
+	free (dir);
+	
+	return ok;
+}
+
+/*
+ * Append size bytes (zeroes if data is NULL) 16 byte aligned, returns
+ * their offset or 0 if none. Once memory ran out nothing more is added.
+ */
+static unsigned long
+image_put (struct CacheImage *image, const void *data, size_t size)
+{
+	unsigned long offset;
+	
+	if (!size || image->out_of_memory) {
+		return 0;
+	}
+	
+	offset = (image->len + 15) & ~15UL;
+	if (offset + size > image->size) {
+		size_t new_size = image->size;
+		char *buf;
+		
+		while (offset + size > new_size) {
+			new_size = new_size ? new_size * 2 : 4096;
+		}
+		buf = realloc (image->buf, new_size);
+		if (!buf) {
+			image->out_of_memory = 1;
+			return 0;
+		}
+		image->buf = buf;
+		image->size = new_size;
+	}
+	
+	memset (image->buf + image->len, 0, offset - image->len);
+	if (data) {
+		memcpy (image->buf + offset, data, size);
+	} else {
+		memset (image->buf + offset, 0, size);
+	}
+	image->len = offset + size;
+	
+	return offset;
+}
+
+static unsigned long
+image_put_crtc_info (struct CacheImage *image, XRRCrtcInfo *info)
+{
+	XRRCrtcInfo copy = *info;
+	unsigned long outputs;
+	int room;
+	
+	/* keep room for every possible output, see crtc_info_update () */
+	room = info->noutput > info->npossible ? info->noutput : info->npossible;
+	outputs = image_put (image, NULL, room * sizeof (RROutput));
+	if (outputs) {
+		memcpy (image->buf + outputs, info->outputs, info->noutput * sizeof (RROutput));
+	}
+	
+	copy.outputs = IMAGE_OFFSET (outputs);
+	copy.possible = IMAGE_OFFSET (image_put (image, info->possible, 
+														  info->npossible * sizeof (RROutput)));
+	
+	return image_put (image, &copy, sizeof (copy));
+}
+
+static unsigned long
+image_put_output_info (struct CacheImage *image, XRROutputInfo *info)
+{
+	XRROutputInfo copy = *info;
+	
+	copy.name = IMAGE_OFFSET (image_put (image, info->name, info->nameLen + 1));
+	copy.crtcs = IMAGE_OFFSET (image_put (image, info->crtcs, info->ncrtc * sizeof (RRCrtc)));
+	copy.clones = IMAGE_OFFSET (image_put (image, info->clones, 
+														info->nclone * sizeof (RROutput)));
+	copy.modes = IMAGE_OFFSET (image_put (image, info->modes, info->nmode * sizeof (RRMode)));
+	
+	return image_put (image, &copy, sizeof (copy));
+}
+
+static unsigned long
+image_put_resources (struct CacheImage *image, XRRScreenResources *res)
+{
+	XRRScreenResources copy = *res;
+	unsigned long modes;
+	int i;
+	
+	copy.crtcs = IMAGE_OFFSET (image_put (image, res->crtcs, res->ncrtc * sizeof (RRCrtc)));
+	copy.outputs = IMAGE_OFFSET (image_put (image, res->outputs, 
+														 res->noutput * sizeof (RROutput)));
+	modes = image_put (image, res->modes, res->nmode * sizeof (XRRModeInfo));
+	copy.modes = IMAGE_OFFSET (modes);
+	
+	for (i = 0; i < res->nmode; i++) {
+		unsigned long name = image_put (image, res->modes[i].name, 
+												  res->modes[i].nameLength + 1);
+		
+		if (image->out_of_memory) {
+			return 0;
+		}
+		((XRRModeInfo *) (image->buf + modes))[i].name = IMAGE_OFFSET (name);
+	}
+	
+	return image_put (image, &copy, sizeof (copy));
+}
+
+/*
+ * Keep the replies behind a snapshot just read from the server for the
+ * next start. Call it before events have touched the snapshot. Returns
+ * 1 once the file is in place, it is replaced atomically.
+ */
+int
+snapshot_cache_save (struct ScreenInfo *screen_info)
+{
+	XRRScreenResources *res = screen_info->res;
+	struct CacheImage image = { NULL, 0, 0, 0 };
+	struct CacheHeader header;
+	unsigned long crtc_infos, output_infos;
+	char *path, *tmp_path;
+	FILE *file = NULL;
+	int ok, fd;
+	int i;
+	
+	path = cache_path (screen_info->dpy);
+	if (!path) {
+		return 0;
+	}
+	if (!cache_dir_ready (path, 1)) {
+		log_warn ("%s: no private directory for the startup cache", path);
+		free (path);
+		return 0;
+	}
+	
+	trace_begin ("cache_save", 0);
+	
+	memset (&header, 0, sizeof (header));
+	image_put (&image, NULL, sizeof (header));
+	
+	crtc_infos = image_put (&image, NULL, res->ncrtc * sizeof (unsigned long));
+	for (i = 0; i < res->ncrtc; i++) {
+		unsigned long info = image_put_crtc_info (&image, screen_info->crtcs[i].info);
+		
+		if (image.out_of_memory) {
+			break;
+		}
+		((unsigned long *) (image.buf + crtc_infos))[i] = info;
+	}
+	output_infos = image_put (&image, NULL, res->noutput * sizeof (unsigned long));
+	for (i = 0; i < res->noutput; i++) {
+		unsigned long info = image_put_output_info (&image, screen_info->outputs[i].info);
+		
+		if (image.out_of_memory) {
+			break;
+		}
+		((unsigned long *) (image.buf + output_infos))[i] = info;
+	}
+	
+	memcpy (header.magic, CACHE_MAGIC, sizeof (header.magic));
+	header.version = CACHE_VERSION;
+	cache_sizes (header.sizes);
+	header.root = screen_info->window;
+	header.min_width = screen_info->min_width;
+	header.min_height = screen_info->min_height;
+	header.max_width = screen_info->max_width;
+	header.max_height = screen_info->max_height;
+	header.res = image_put_resources (&image, res);
+	header.crtc_infos = crtc_infos;
+	header.output_infos = output_infos;
+	header.size = image.len;
+	
+	tmp_path = malloc (strlen (path) + 32);
+	if (image.out_of_memory || !tmp_path) {
+		log_warn ("%s: out of memory for the startup cache", path);
+		free (tmp_path);
+		free (path);
+		free (image.buf);
+		trace_end ("cache_save", 0);
+		return 0;
+	}
+	memcpy (image.buf, &header, sizeof (header));
+	sprintf (tmp_path, "%s.%d", path, (int) getpid ());
+	
+	/* the directory is private, anything by this name is our own leftover */
+	unlink (tmp_path);
+	fd = open (tmp_path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+	if (fd >= 0) {
+		file = fdopen (fd, "w");
+		if (!file) {
+			close (fd);
+		}
+	}
+	ok = file && fwrite (image.buf, 1, image.len, file) == image.len;
+	if (file && fclose (file) != 0) {
+		ok = 0;
+	}
+	if (ok && rename (tmp_path, path) != 0) {
+		ok = 0;
+	}
+	if (!ok) {
+		log_warn ("%s: cannot write startup cache: %s", path, strerror (errno));
+		unlink (tmp_path);
+	} else {
+		log_info ("%s: %lu bytes cached", path, (unsigned long) image.len);
+	}
+	
+	free (tmp_path);
+	free (path);
+	free (image.buf);
+	trace_end ("cache_save", 0);
+	
+	return ok;
+}
+
+/*
+ * Turn the file offset stored in the pointer at field back into a
+ * pointer into the mapping, if n objects of size bytes fit there.
+ */
+static int
+relocate (char *map, size_t map_size, void *field, long n, size_t size)
+{
+	unsigned long offset;
+	void *ptr = NULL;
+	
+	memcpy (&offset, field, sizeof (offset));
+	if (n < 0 || (!offset && n)) {
+		return 0;
+	}
+	if (offset) {
+		/* image_put () aligns everything to 16 bytes */
+		if (offset % 16 || offset > map_size || 
+			 (unsigned long) n > (map_size - offset) / size) {
+			return 0;
+		}
+		ptr = map + offset;
+	}
+	memcpy (field, &ptr, sizeof (ptr));
+	
+	return 1;
+}
+
+static int
+relocate_string (char *map, size_t map_size, char **field, int len)
+{
+	return relocate (map, map_size, field, len + 1, 1) && *field && (*field)[len] == '\0';
+}
+
+static int
+relocate_resources (char *map, size_t map_size, XRRScreenResources *res)
+{
+	int i;
+	
+	if (!relocate (map, map_size, &res->crtcs, res->ncrtc, sizeof (RRCrtc)) ||
+		 !relocate (map, map_size, &res->outputs, res->noutput, sizeof (RROutput)) ||
+		 !relocate (map, map_size, &res->modes, res->nmode, sizeof (XRRModeInfo))) {
+		return 0;
+	}
+	for (i = 0; i < res->nmode; i++) {
+		if (!relocate_string (map, map_size, &res->modes[i].name, res->modes[i].nameLength)) {
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+static int
+relocate_crtc_info (char *map, size_t map_size, XRRCrtcInfo *info)
+{
+	int room = info->noutput > info->npossible ? info->noutput : info->npossible;
+	
+	return relocate (map, map_size, &info->outputs, room, sizeof (RROutput)) &&
+		relocate (map, map_size, &info->possible, info->npossible, sizeof (RROutput));
+}
+
+static int
+relocate_output_info (char *map, size_t map_size, XRROutputInfo *info)
+{
+	return relocate_string (map, map_size, &info->name, info->nameLen) &&
+		relocate (map, map_size, &info->crtcs, info->ncrtc, sizeof (RRCrtc)) &&
+		relocate (map, map_size, &info->clones, info->nclone, sizeof (RROutput)) &&
+		relocate (map, map_size, &info->modes, info->nmode, sizeof (RRMode));
+}
+
+/* point replies into the mapped image, 0 if it does not hold together */
+static int
+cache_replies (char *map, size_t map_size, struct ScreenReplies *replies)
+{
+	struct CacheHeader *header = (struct CacheHeader *) map;
+	XRRScreenResources *res;
+	int i;
+	
+	replies->min_width = header->min_width;
+	replies->min_height = header->min_height;
+	replies->max_width = header->max_width;
+	replies->max_height = header->max_height;
+	
+	if (!relocate (map, map_size, &header->res, 1, sizeof (XRRScreenResources)) ||
+		 !header->res) {
+		return 0;
+	}
+	res = (XRRScreenResources *) IMAGE_OFFSET (header->res);
+	if (!relocate_resources (map, map_size, res) || res->noutput < 1) {
+		return 0;
+	}
+	replies->res = res;
+	
+	if (!relocate (map, map_size, &header->crtc_infos, res->ncrtc, sizeof (XRRCrtcInfo *)) ||
+		 !relocate (map, map_size, &header->output_infos, res->noutput, sizeof (XRROutputInfo *))) {
+		return 0;
+	}
+	replies->crtc_infos = (XRRCrtcInfo **) IMAGE_OFFSET (header->crtc_infos);
+	replies->output_infos = (XRROutputInfo **) IMAGE_OFFSET (header->output_infos);
+	
+	for (i = 0; i < res->ncrtc; i++) {
+		if (!relocate (map, map_size, &replies->crtc_infos[i], 1, sizeof (XRRCrtcInfo)) ||
+			 !replies->crtc_infos[i] ||
+			 !relocate_crtc_info (map, map_size, replies->crtc_infos[i])) {
+			return 0;
+		}
+	}
+	for (i = 0; i < res->noutput; i++) {
+		if (!relocate (map, map_size, &replies->output_infos[i], 1, sizeof (XRROutputInfo)) ||
+			 !replies->output_infos[i] ||
+			 !relocate_output_info (map, map_size, replies->output_infos[i])) {
+			return 0;
+		}
+	}
+	
+	return 1;
+}
+
+/*
+ * The snapshot the last run cached for this display, NULL if there is
+ * none or it is not usable. Costs no round trip; whether the server
+ * moved on since is left to snapshot_cache_confirm ().
+ */
+struct ScreenInfo *
+snapshot_cache_load (Display *display)
+{
+	struct ScreenInfo *screen_info;
+	struct ScreenReplies replies;
+	struct CacheHeader *header;
+	unsigned short sizes[6];
+	struct stat st;
+	char *path;
+	char *map;
+	int fd;
+	
+	path = cache_path (display);
+	if (!path) {
+		return NULL;
+	}
+	
+	trace_begin ("cache_load", 0);
+	fd = cache_dir_ready (path, 0) ? open (path, O_RDONLY) : -1;
+	if (fd < 0) {
+		log_info ("%s: no startup cache", path);
+		free (path);
+		trace_end ("cache_load", 0);
+		return NULL;
+	}
+	
+	map = MAP_FAILED;
+	if (fstat (fd, &st) == 0 && cache_trusted (&st) &&
+		 st.st_size >= (off_t) sizeof (struct CacheHeader)) {
+		/* private and writable: relocating only dirties our copy of a page */
+		map = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	}
+	close (fd);
+	if (MAP_FAILED == map) {
+		log_warn ("%s: cannot map startup cache", path);
+		free (path);
+		trace_end ("cache_load", 0);
+		return NULL;
+	}
+	
+	randr_backend->get_screen (display, &replies.root, &replies.width, &replies.height,
+										&replies.mm_width, &replies.mm_height);
+	
+	header = (struct CacheHeader *) map;
+	cache_sizes (sizes);
+	if (memcmp (header->magic, CACHE_MAGIC, sizeof (header->magic)) != 0 ||
+		 header->version != CACHE_VERSION ||
+		 memcmp (header->sizes, sizes, sizeof (sizes)) != 0 ||
+		 header->size != (unsigned long) st.st_size ||
+		 header->root != replies.root ||
+		 !cache_replies (map, st.st_size, &replies)) {
+		log_warn ("%s: startup cache does not fit, ignored", path);
+		munmap (map, st.st_size);
+		free (path);
+		trace_end ("cache_load", 0);
+		return NULL;
+	}
+	
+	screen_info = screen_info_from_replies (display, &replies, map, st.st_size);
+	if (!screen_info) {
+		munmap (map, st.st_size);
+	} else {
+		log_info ("%s: snapshot from cache", path);
+	}
+	free (path);
+	trace_end ("cache_load", 0);
+	
+	return screen_info;
+}
+
+/*
+ * One round trip: does the server still have the configuration the
+ * snapshot was cached with? Every change of crtcs or outputs moves the
+ * screen resources' timestamp or configTimestamp.
+ */
+int
+snapshot_cache_confirm (struct ScreenInfo *screen_info)
+{
+	XRRScreenResources *res;
+	struct Arena scratch;
+	int ok;
+	
+	trace_begin ("cache_confirm", 0);
+	arena_init (&scratch, 0);
+	res = get_screen_resources (screen_info->dpy, screen_info->window, 0, &scratch);
+	ok = res && res->timestamp == screen_info->res->timestamp &&
+		res->configTimestamp == screen_info->res->configTimestamp;
+	arena_free (&scratch);
+	trace_end ("cache_confirm", 0);
+	
+	return ok;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+/* a GUI or daemon left tracing for days stops recording here */
+#define TRACE_MAX_EVENTS	(1 << 20)
+
+struct TraceEvent {
+	const char *name;
+	char phase;				/* Chrome ph: B E b e C */
+	double ts;				/* us */
+	unsigned long id;
+	long value;				/* C: the counter */
+};
+
+int trace_enabled = 0;
+
+static struct {
+	char *path;
+	struct TraceEvent *events;
+	int n_event;
+	int size;
+	long dropped;
+	long round_trips;
+} trace;
+
+static double
+trace_now (void)
+{
+	struct timespec ts;
+	
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void
+trace_add (char phase, const char *name, unsigned long id, long value)
+{
+	struct TraceEvent *event, *events;
+	int size;
+	
+	if (trace.n_event == trace.size) {
+		if (trace.size == TRACE_MAX_EVENTS) {
+			trace.dropped++;
+			return;
+		}
+		size = trace.size ? trace.size * 2 : 1024;
+		events = realloc (trace.events, sizeof (struct TraceEvent) * size);
+		if (!events) {
+			/* counted like the events past the cap */
+			trace.dropped++;
+			return;
+		}
+		trace.events = events;
+		trace.size = size;
+	}
+	
+	event = &trace.events[trace.n_event++];
+	event->name = name;
+	event->phase = phase;
+	event->ts = trace_now ();
+	event->id = id;
+	event->value = value;
+}
+
+static void
+trace_exit (void)
+{
+	trace_flush ();
+	free (trace.events);
+	free (trace.path);
+	trace_enabled = 0;
+}
+
+/*
+ * Start tracing into path, or into $GRANDR_TRACE when path is NULL.
+ * The trace is written at exit. Returns 1 if tracing is on.
+ */
+int
+trace_init (const char *path)
+{
+	if (!path) {
+		path = getenv ("GRANDR_TRACE");
+	}
+	if (!path || !*path || trace_enabled) {
+		return trace_enabled;
+	}
+	
+	trace.path = strdup (path);
+	if (!trace.path) {
+		return 0;
+	}
+	trace_enabled = 1;
+	atexit (trace_exit);
+	
+	return 1;
+}
+
+void
+trace_begin (const char *name, unsigned long xid)
+{
+	if (trace_enabled) {
+		trace_add ('B', name, xid, 0);
+	}
+}
+
+void
+trace_end (const char *name, unsigned long xid)
+{
+	if (trace_enabled) {
+		trace_add ('E', name, xid, 0);
+	}
+}
+
+void
+trace_async_begin (const char *name, unsigned long id)
+{
+	if (trace_enabled) {
+		trace_add ('b', name, id, 0);
+	}
+}
+
+void
+trace_async_end (const char *name, unsigned long id)
+{
+	if (trace_enabled) {
+		trace_add ('e', name, id, 0);
+	}
+}
+
+/* n more blocking waits on the server */
+void
+trace_round_trips (int n)
+{
+	if (trace_enabled && n > 0) {
+		trace.round_trips += n;
+		trace_add ('C', "x_round_trips", 0, trace.round_trips);
+	}
+}
+
+/* write everything recorded so far, the file is rewritten each time */
+void
+trace_flush (void)
+{
+	FILE *file;
+	double start;
+	int pid = getpid ();
+	int i;
+	
+	if (!trace_enabled) {
+		return;
+	}
+	
+	file = fopen (trace.path, "w");
+	if (!file) {
+		fprintf (stderr, "%s: cannot write trace\n", trace.path);
+		return;
+	}
+	
+	start = trace.n_event ? trace.events[0].ts : 0;
+	fprintf (file, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped_events\":%ld},\n"
+				"\"traceEvents\":[\n", trace.dropped);
+	for (i = 0; i < trace.n_event; i++) {
+		struct TraceEvent *event = &trace.events[i];
+		
+		fprintf (file, "{\"name\":\"%s\",\"cat\":\"grandr\",\"ph\":\"%c\",\"ts\":%.3f,"
+					"\"pid\":%d,\"tid\":%d",
+					event->name, event->phase, event->ts - start, pid, pid);
+		if ('C' == event->phase) {
+			fprintf (file, ",\"args\":{\"count\":%ld}", event->value);
+		} else if ('b' == event->phase || 'e' == event->phase) {
+			fprintf (file, ",\"id\":\"0x%lx\"", event->id);
+		} else if (event->id) {
+			fprintf (file, ",\"args\":{\"xid\":\"0x%lx\"}", event->id);
+		}
+		fprintf (file, "}%s\n", i + 1 < trace.n_event ? "," : "");
+	}
+	fprintf (file, "]}\n");
+	
+	fclose (file);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_TRACE_H
+#define RANDR_GUI_TRACE_H
+
+/*
+ * Phase timing and X round trip counts, off unless $GRANDR_TRACE or
+ * --trace names a file. Events are kept in memory and written at exit in
+ * the Chrome trace format (chrome://tracing, ui.perfetto.dev). Names
+ * must be string literals, only the pointer is kept. With tracing off
+ * every call is a flag test.
+ *
+ * begin/end pairs nest, as phases of one thread. The async pairs cover
+ * requests in flight together, matched by id (usually the XID).
+ */
+extern int trace_enabled;
+
+int trace_init (const char *path);
+void trace_begin (const char *name, unsigned long xid);
+void trace_end (const char *name, unsigned long xid);
+void trace_async_begin (const char *name, unsigned long id);
+void trace_async_end (const char *name, unsigned long id);
+void trace_round_trips (int n);
+void trace_flush (void);
+
+#endif
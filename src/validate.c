@@ -0,0 +1,239 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+/*
+ * Check a pending configuration against what the snapshot already knows
+ * the hardware can do, so mistakes are caught without a server round trip
+ * (or a grab and a flicker). Everything is a bitset test or a walk over
+ * the lit crtcs, cheap enough to run on every edit in the GUI.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "validate.h"
+#include "assign.h"
+#include "bitset.h"
+
+static int
+crtc_is_lit (struct CrtcInfo *crtc_info)
+{
+	return crtc_info->cur_noutput > 0 && crtc_info->cur_mode_id != None;
+}
+
+static int
+crtc_extent (struct ScreenInfo *screen_info, struct CrtcInfo *crtc_info, int *w, int *h)
+{
+	XRRModeInfo *mode_info;
+	
+	mode_info = find_mode_by_xid (screen_info, crtc_info->cur_mode_id);
+	if (!mode_info) {
+		return 0;
+	}
+	*w = mode_width (mode_info, crtc_info->cur_rotation);
+	*h = mode_height (mode_info, crtc_info->cur_rotation);
+	
+	return 1;
+}
+
+/* 
+ * Outputs sharing a crtc: all of them in the clone mask of each of them.
+ * Works in the crtcs' members/allowed bitsets, set aside by the snapshot.
+ */
+static int
+check_clones (struct ScreenInfo *screen_info, FILE *err)
+{
+	size_t set_size = bitset_words (screen_info->n_output) * sizeof (unsigned long);
+	int problems = 0;
+	int i, c;
+	
+	for (c = 0; c < screen_info->n_crtc; c++) {
+		memset (screen_info->crtcs[c].members, 0, set_size);
+		bitset_fill (screen_info->crtcs[c].allowed, screen_info->n_output);
+	}
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct OutputInfo *output = &screen_info->outputs[i];
+		
+		if (!output->cur_crtc) {
+			continue;
+		}
+		bitset_set (output->cur_crtc->members, i);
+		bitset_and (output->cur_crtc->allowed, output->clone_mask, screen_info->n_output);
+	}
+	
+	for (c = 0; c < screen_info->n_crtc; c++) {
+		struct CrtcInfo *crtc_info = &screen_info->crtcs[c];
+		
+		for (i = 0; i < screen_info->n_output; i++) {
+			if (bitset_test (crtc_info->members, i) && !bitset_test (crtc_info->allowed, i)) {
+				if (err) {
+					fprintf (err, "%s: can not be cloned with the other outputs on its crtc\n",
+								screen_info->outputs[i].info->name);
+				}
+				problems |= INVALID_CLONE;
+			}
+		}
+	}
+	
+	return problems;
+}
+
+/* lit crtcs may share an origin (cloning by position) but not partly overlap */
+static int
+check_overlap (struct ScreenInfo *screen_info, FILE *err)
+{
+	int i, j;
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		struct CrtcInfo *a = &screen_info->crtcs[i];
+		int aw, ah;
+		
+		if (!crtc_is_lit (a) || !crtc_extent (screen_info, a, &aw, &ah)) {
+			continue;
+		}
+		for (j = i + 1; j < screen_info->n_crtc; j++) {
+			struct CrtcInfo *b = &screen_info->crtcs[j];
+			int bw, bh;
+			
+			if (!crtc_is_lit (b) || !crtc_extent (screen_info, b, &bw, &bh)) {
+				continue;
+			}
+			if (a->cur_x == b->cur_x && a->cur_y == b->cur_y) {
+				continue;
+			}
+			if (a->cur_x < b->cur_x + bw && b->cur_x < a->cur_x + aw &&
+				 a->cur_y < b->cur_y + bh && b->cur_y < a->cur_y + ah) {
+				if (err) {
+					fprintf (err, "crtcs 0x%lx and 0x%lx overlap\n", a->id, b->id);
+				}
+				return INVALID_OVERLAP;
+			}
+		}
+	}
+	
+	return 0;
+}
+
+/*
+ * Check the pending state of screen_info. Returns 0 if it can be applied,
+ * else a mask of INVALID_* problems, each explained on err (may be NULL).
+ * Nothing is changed.
+ */
+int
+validate_screen_info (struct ScreenInfo *screen_info, FILE *err)
+{
+	int problems = 0;
+	int width = 0, height = 0;
+	int w, h;
+	int i, index;
+	
+	for (i = 0; i < screen_info->n_output; i++) {
+		struct OutputInfo *output = &screen_info->outputs[i];
+		struct CrtcInfo *crtc_info = output->cur_crtc;
+		
+		if (!crtc_info || !crtc_is_lit (crtc_info)) {
+			continue;
+		}
+		
+		index = xid_hash_lookup (&screen_info->mode_hash, crtc_info->cur_mode_id);
+		if (index < 0 || !bitset_test (output->mode_mask, index)) {
+			if (err) {
+				fprintf (err, "%s: mode 0x%lx not supported\n", 
+							output->info->name, crtc_info->cur_mode_id);
+			}
+			problems |= INVALID_MODE;
+		}
+	}
+	
+	for (i = 0; i < screen_info->n_crtc; i++) {
+		struct CrtcInfo *crtc_info = &screen_info->crtcs[i];
+		
+		if (!crtc_is_lit (crtc_info)) {
+			continue;
+		}
+		/* every bit, reflections included */
+		if ((crtc_info->rotations & crtc_info->cur_rotation) != crtc_info->cur_rotation) {
+			if (err) {
+				fprintf (err, "crtc 0x%lx: rotation not supported\n", crtc_info->id);
+			}
+			problems |= INVALID_ROTATION;
+		}
+		if (crtc_extent (screen_info, crtc_info, &w, &h)) {
+			if (crtc_info->cur_x < 0 || crtc_info->cur_y < 0) {
+				problems |= INVALID_SIZE;
+			}
+			if (crtc_info->cur_x + w > width) {
+				width = crtc_info->cur_x + w;
+			}
+			if (crtc_info->cur_y + h > height) {
+				height = crtc_info->cur_y + h;
+			}
+		}
+	}
+	
+	/* set_screen_size () pads a smaller screen up to the minimum */
+	if (width < screen_info->min_width) {
+		width = screen_info->min_width;
+	}
+	if (height < screen_info->min_height) {
+		height = screen_info->min_height;
+	}
+	if (width > screen_info->max_width || height > screen_info->max_height) {
+		problems |= INVALID_SIZE;
+	}
+	if ((problems & INVALID_SIZE) && err) {
+		fprintf (err, "screen %dx%d outside %dx%d - %dx%d\n", width, height,
+					screen_info->min_width, screen_info->min_height,
+					screen_info->max_width, screen_info->max_height);
+	}
+	
+	problems |= check_clones (screen_info, err);
+	problems |= check_overlap (screen_info, err);
+	
+	/* only worth matching crtcs once the groups themselves make sense */
+	if (!(problems & (INVALID_CLONE | INVALID_ROTATION)) &&
+		 !check_crtc_assignment (screen_info, err)) {
+		problems |= INVALID_CRTC;
+	}
+	
+	return problems;
+}
+
+/* a one line description of the first problem in the mask */
+const char *
+validate_message (int problems)
+{
+	if (problems & INVALID_MODE) {
+		return "An output does not support the selected mode";
+	} else if (problems & INVALID_CRTC) {
+		return "Not enough CRTCs can drive the selected outputs";
+	} else if (problems & INVALID_CLONE) {
+		return "These outputs can not show the same picture";
+	} else if (problems & INVALID_ROTATION) {
+		return "The selected rotation is not supported";
+	} else if (problems & INVALID_SIZE) {
+		return "The layout does not fit the screen size limits";
+	} else if (problems & INVALID_OVERLAP) {
+		return "Outputs overlap each other";
+	}
+	
+	return NULL;
+}
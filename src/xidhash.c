@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "xidhash.h"
+
+static unsigned int
+xid_hash_slot (const struct XidHash *hash, XID key)
+{
+	unsigned int h = (unsigned int) key;
+	
+	h ^= h >> 16;
+	h *= 0x45d9f3b;
+	h ^= h >> 16;
+	
+	return h & (hash->size - 1);
+}
+
+/* 
+ * Size the table for n entries, keeping the load factor at or below 1/2.
+ * The slots live in arena and go away with it. Returns 0 if arena ran out.
+ */
+int
+xid_hash_init (struct XidHash *hash, int n, struct Arena *arena)
+{
+	int size = 8;
+	
+	while (size < 2 * n) {
+		size <<= 1;
+	}
+	
+	hash->size = size;
+	hash->keys = arena_alloc (arena, size * sizeof (XID));
+	hash->values = arena_alloc (arena, size * sizeof (int));
+	
+	return hash->keys && hash->values;
+}
+
+void
+xid_hash_insert (struct XidHash *hash, XID key, int value)
+{
+	unsigned int slot;
+	
+	slot = xid_hash_slot (hash, key);
+	while (hash->keys[slot] && hash->keys[slot] != key) {
+		slot = (slot + 1) & (hash->size - 1);
+	}
+	
+	hash->keys[slot] = key;
+	hash->values[slot] = value;
+}
+
+/* return the index stored for key, or -1 */
+int
+xid_hash_lookup (const struct XidHash *hash, XID key)
+{
+	unsigned int slot;
+	
+	if (!key || !hash->keys) {
+		return -1;
+	}
+	
+	slot = xid_hash_slot (hash, key);
+	while (hash->keys[slot]) {
+		if (hash->keys[slot] == key) {
+			return hash->values[slot];
+		}
+		slot = (slot + 1) & (hash->size - 1);
+	}
+	
+	return -1;
+}
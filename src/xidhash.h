@@ -0,0 +1,43 @@
+/*
+ * Copyright © 2007 Intel Corporation
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef RANDR_GUI_XIDHASH_H
+#define RANDR_GUI_XIDHASH_H
+
+#include <X11/Xlib.h>
+
+#include "arena.h"
+
+/* 
+ * Open addressing table mapping an XID (mode, output or crtc id) to its
+ * index in the snapshot arrays. XIDs are never 0, so 0 marks a free slot.
+ */
+struct XidHash {
+	int size;		/* number of slots, a power of two */
+	XID *keys;
+	int *values;
+};
+
+int xid_hash_init (struct XidHash *hash, int n, struct Arena *arena);
+void xid_hash_insert (struct XidHash *hash, XID key, int value);
+int xid_hash_lookup (const struct XidHash *hash, XID key);
+
+#endif